@@ -0,0 +1,451 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "simd_sum.h"
+
+/**
+ * Overflow-safe and compensated summation kernels. Integers can be widened
+ * to 64 bits (int inputs) or 128 bits (int64 inputs); float and double
+ * inputs are summed in double with plain, Kahan, Neumaier or pairwise
+ * accumulation. Every mode has an AVX2 kernel that keeps the precision
+ * bookkeeping per lane, so accuracy doesn't give up the vector throughput.
+ * Pre-AVX2 CPUs fall back to the scalar loops. The deterministic mode gives
+ * bit-identical results for any thread count, CPU and SIMD level
+ */
+enum class sum_mode { fast, kahan, neumaier, pairwise, deterministic };
+
+inline const char *sum_mode_name(sum_mode m) {
+    switch (m) {
+        case sum_mode::kahan:
+            return "kahan";
+        case sum_mode::neumaier:
+            return "neumaier";
+        case sum_mode::pairwise:
+            return "pairwise";
+        case sum_mode::deterministic:
+            return "deterministic";
+        default:
+            return "fast";
+    }
+}
+
+#ifdef __SIZEOF_INT128__
+using int128 = __int128;
+#endif
+
+/**
+ * A running sum together with the rounding error it has lost so far; the
+ * best estimate of the true sum is sum + err
+ */
+struct compensated {
+    double sum = 0;
+    double err = 0;
+
+    double value() const { return sum + err; }
+};
+
+inline void neumaier_add(compensated &a, double x) {
+    double t = a.sum + x;
+    if (std::fabs(a.sum) >= std::fabs(x)) {
+        a.err += (a.sum - t) + x;
+    } else {
+        a.err += (x - t) + a.sum;
+    }
+    a.sum = t;
+}
+
+// folds two partial results without losing either one's error term
+inline compensated merge_compensated(compensated a, const compensated &b) {
+    neumaier_add(a, b.sum);
+    neumaier_add(a, b.err);
+    return a;
+}
+
+// ---- integer widening -------------------------------------------------
+
+inline long long sum_int_wide_scalar(const int *p, size_t n) {
+    long long a0 = 0, a1 = 0;
+    size_t i = 0;
+    for (; i + 2 <= n; i += 2) {
+        a0 += p[i];
+        a1 += p[i + 1];
+    }
+    if (i < n) a0 += p[i];
+    return a0 + a1;
+}
+
+#ifdef SIMD_SUM_X86
+SIMD_TARGET("sse2") inline long long sum_int_wide_sse2(const int *p, size_t n) {
+    __m128i a0 = _mm_setzero_si128(), a1 = a0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        // sign extend the four ints into two pairs of 64 bit lanes
+        __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i sign = _mm_srai_epi32(v, 31);
+        a0 = _mm_add_epi64(a0, _mm_unpacklo_epi32(v, sign));
+        a1 = _mm_add_epi64(a1, _mm_unpackhi_epi32(v, sign));
+    }
+    alignas(16) long long lanes[2];
+    _mm_store_si128((__m128i *)lanes, _mm_add_epi64(a0, a1));
+    return lanes[0] + lanes[1] + sum_int_wide_scalar(p + i, n - i);
+}
+
+SIMD_TARGET("avx2") inline long long sum_int_wide_avx2(const int *p, size_t n) {
+    __m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(p + i + 4));
+        __m128i v2 = _mm_loadu_si128((const __m128i *)(p + i + 8));
+        __m128i v3 = _mm_loadu_si128((const __m128i *)(p + i + 12));
+        a0 = _mm256_add_epi64(a0, _mm256_cvtepi32_epi64(v0));
+        a1 = _mm256_add_epi64(a1, _mm256_cvtepi32_epi64(v1));
+        a2 = _mm256_add_epi64(a2, _mm256_cvtepi32_epi64(v2));
+        a3 = _mm256_add_epi64(a3, _mm256_cvtepi32_epi64(v3));
+    }
+    __m256i acc = _mm256_add_epi64(_mm256_add_epi64(a0, a1), _mm256_add_epi64(a2, a3));
+    alignas(32) long long lanes[4];
+    _mm256_store_si256((__m256i *)lanes, acc);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_int_wide_scalar(p + i, n - i);
+}
+
+SIMD_TARGET("avx512f") inline long long sum_int_wide_avx512(const int *p, size_t n) {
+    __m512i a0 = _mm512_setzero_si512(), a1 = a0;
+    size_t i = 0;
+    // the zero-masked forms sidestep a GCC 12 -Wmaybe-uninitialized false
+    // positive on the plain conversions
+    for (; i + 16 <= n; i += 16) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(p + i + 8));
+        a0 = _mm512_add_epi64(a0, _mm512_maskz_cvtepi32_epi64(0xff, v0));
+        a1 = _mm512_add_epi64(a1, _mm512_maskz_cvtepi32_epi64(0xff, v1));
+    }
+    alignas(64) long long lanes[8];
+    _mm512_store_si512(lanes, _mm512_add_epi64(a0, a1));
+    long long total = 0;
+    for (long long l : lanes) total += l;
+    return total + sum_int_wide_scalar(p + i, n - i);
+}
+#endif
+
+/**
+ * Sums ints into a 64 bit total, which can't overflow below 2^32 elements
+ */
+inline long long sum_int_wide(const int *p, size_t n) {
+#ifdef SIMD_SUM_X86
+    switch (active_simd_level()) {
+        case simd_level::avx512:
+            return sum_int_wide_avx512(p, n);
+        case simd_level::avx2:
+            return sum_int_wide_avx2(p, n);
+        case simd_level::sse2:
+            return sum_int_wide_sse2(p, n);
+        default:
+            break;
+    }
+#endif
+    return sum_int_wide_scalar(p, n);
+}
+
+#ifdef __SIZEOF_INT128__
+inline int128 sum_int64_wide_scalar(const long long *p, size_t n) {
+    int128 acc = 0;
+    for (size_t i = 0; i < n; i++) acc += p[i];
+    return acc;
+}
+
+#ifdef SIMD_SUM_X86
+/**
+ * 128 bit sums split every int64 into an unsigned low half and a signed
+ * high half, each summed in 64 bit lanes. A lane gains less than 2^32 per
+ * element, so a block of up to 2^31 elements per lane can't overflow and
+ * the halves are recombined in 128 bits once per block
+ */
+inline constexpr size_t wide128_block = (size_t)1 << 30;
+
+// the high halves are scaled by multiplying, as shifting a negative int128
+// left is undefined before C++20
+inline constexpr int128 two32 = (int128)1 << 32;
+
+SIMD_TARGET("avx2") inline int128 sum_int64_wide_avx2(const long long *p, size_t n) {
+    const __m256i lowMask = _mm256_set1_epi64x(0xffffffffLL);
+    int128 total = 0;
+    size_t i = 0;
+    while (i + 4 <= n) {
+        __m256i lo = _mm256_setzero_si256(), hi = lo;
+        size_t blockEnd = n - i > wide128_block ? i + wide128_block : n;
+        for (; i + 4 <= blockEnd; i += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i *)(p + i));
+            lo = _mm256_add_epi64(lo, _mm256_and_si256(v, lowMask));
+            // AVX2 has no 64 bit arithmetic shift, so build v >> 32 from a
+            // logical shift and the sign of the upper dword
+            __m256i sign = _mm256_srai_epi32(v, 31);
+            hi = _mm256_add_epi64(hi, _mm256_blend_epi32(_mm256_srli_epi64(v, 32), sign, 0xaa));
+        }
+        alignas(32) unsigned long long los[4];
+        alignas(32) long long his[4];
+        _mm256_store_si256((__m256i *)los, lo);
+        _mm256_store_si256((__m256i *)his, hi);
+        for (int l = 0; l < 4; l++) total += (int128)los[l] + (int128)his[l] * two32;
+    }
+    return total + sum_int64_wide_scalar(p + i, n - i);
+}
+
+SIMD_TARGET("avx512f") inline int128 sum_int64_wide_avx512(const long long *p, size_t n) {
+    const __m512i lowMask = _mm512_set1_epi64(0xffffffffLL);
+    int128 total = 0;
+    size_t i = 0;
+    while (i + 8 <= n) {
+        __m512i lo = _mm512_setzero_si512(), hi = lo;
+        size_t blockEnd = n - i > wide128_block ? i + wide128_block : n;
+        for (; i + 8 <= blockEnd; i += 8) {
+            __m512i v = _mm512_loadu_si512(p + i);
+            lo = _mm512_add_epi64(lo, _mm512_and_si512(v, lowMask));
+            hi = _mm512_add_epi64(hi, _mm512_maskz_srai_epi64(0xff, v, 32));
+        }
+        alignas(64) unsigned long long los[8];
+        alignas(64) long long his[8];
+        _mm512_store_si512(los, lo);
+        _mm512_store_si512(his, hi);
+        for (int l = 0; l < 8; l++) total += (int128)los[l] + (int128)his[l] * two32;
+    }
+    return total + sum_int64_wide_scalar(p + i, n - i);
+}
+#endif
+
+/**
+ * Sums int64 values into a 128 bit total
+ */
+inline int128 sum_int64_wide(const long long *p, size_t n) {
+#ifdef SIMD_SUM_X86
+    switch (active_simd_level()) {
+        case simd_level::avx512:
+            return sum_int64_wide_avx512(p, n);
+        case simd_level::avx2:
+            return sum_int64_wide_avx2(p, n);
+        default:
+            break;
+    }
+#endif
+    return sum_int64_wide_scalar(p, n);
+}
+#endif
+
+// ---- floating point ---------------------------------------------------
+
+template <typename T>
+compensated sum_fp_scalar(const T *p, size_t n, sum_mode mode) {
+    compensated acc;
+    switch (mode) {
+        case sum_mode::kahan:
+            for (size_t i = 0; i < n; i++) {
+                double y = (double)p[i] + acc.err;
+                double t = acc.sum + y;
+                acc.err = y - (t - acc.sum);
+                acc.sum = t;
+            }
+            break;
+        case sum_mode::neumaier:
+            for (size_t i = 0; i < n; i++) neumaier_add(acc, (double)p[i]);
+            break;
+        default: {
+            double a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+            size_t i = 0;
+            for (; i + 4 <= n; i += 4) {
+                a0 += p[i];
+                a1 += p[i + 1];
+                a2 += p[i + 2];
+                a3 += p[i + 3];
+            }
+            for (; i < n; i++) a0 += p[i];
+            acc.sum = (a0 + a1) + (a2 + a3);
+        }
+    }
+    return acc;
+}
+
+#ifdef SIMD_SUM_X86
+SIMD_TARGET("avx2") inline __m256d load4_pd(const double *p) { return _mm256_loadu_pd(p); }
+SIMD_TARGET("avx2") inline __m256d load4_pd(const float *p) {
+    return _mm256_cvtps_pd(_mm_loadu_ps(p));
+}
+
+// folds the lanes of a (sum, err) vector pair with Neumaier merges
+SIMD_TARGET("avx2") inline compensated fold_lanes(__m256d s, __m256d e) {
+    alignas(32) double sums[4], errs[4];
+    _mm256_store_pd(sums, s);
+    _mm256_store_pd(errs, e);
+    compensated acc;
+    for (int l = 0; l < 4; l++) acc = merge_compensated(acc, compensated{sums[l], errs[l]});
+    return acc;
+}
+
+/**
+ * AVX2 double precision kernel for every mode but pairwise. Two sets of
+ * accumulators are interleaved so the dependent add chains of the
+ * compensated modes overlap
+ */
+template <typename T>
+SIMD_TARGET("avx2") compensated sum_fp_avx2(const T *p, size_t n, sum_mode mode) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = s0, e0 = s0, e1 = s0;
+    const __m256d absMask = _mm256_castsi256_pd(_mm256_set1_epi64x(0x7fffffffffffffffLL));
+    size_t i = 0;
+    switch (mode) {
+        case sum_mode::kahan:
+            for (; i + 8 <= n; i += 8) {
+                __m256d y0 = _mm256_add_pd(load4_pd(p + i), e0);
+                __m256d y1 = _mm256_add_pd(load4_pd(p + i + 4), e1);
+                __m256d t0 = _mm256_add_pd(s0, y0);
+                __m256d t1 = _mm256_add_pd(s1, y1);
+                e0 = _mm256_sub_pd(y0, _mm256_sub_pd(t0, s0));
+                e1 = _mm256_sub_pd(y1, _mm256_sub_pd(t1, s1));
+                s0 = t0;
+                s1 = t1;
+            }
+            break;
+        case sum_mode::neumaier:
+            for (; i + 8 <= n; i += 8) {
+                __m256d x0 = load4_pd(p + i), x1 = load4_pd(p + i + 4);
+                __m256d t0 = _mm256_add_pd(s0, x0), t1 = _mm256_add_pd(s1, x1);
+                // per lane: the larger magnitude operand keeps its bits
+                __m256d big0 = _mm256_cmp_pd(_mm256_and_pd(s0, absMask),
+                                             _mm256_and_pd(x0, absMask), _CMP_GE_OQ);
+                __m256d big1 = _mm256_cmp_pd(_mm256_and_pd(s1, absMask),
+                                             _mm256_and_pd(x1, absMask), _CMP_GE_OQ);
+                __m256d sBig0 = _mm256_add_pd(_mm256_sub_pd(s0, t0), x0);
+                __m256d xBig0 = _mm256_add_pd(_mm256_sub_pd(x0, t0), s0);
+                __m256d sBig1 = _mm256_add_pd(_mm256_sub_pd(s1, t1), x1);
+                __m256d xBig1 = _mm256_add_pd(_mm256_sub_pd(x1, t1), s1);
+                e0 = _mm256_add_pd(e0, _mm256_blendv_pd(xBig0, sBig0, big0));
+                e1 = _mm256_add_pd(e1, _mm256_blendv_pd(xBig1, sBig1, big1));
+                s0 = t0;
+                s1 = t1;
+            }
+            break;
+        default:
+            for (; i + 8 <= n; i += 8) {
+                s0 = _mm256_add_pd(s0, load4_pd(p + i));
+                s1 = _mm256_add_pd(s1, load4_pd(p + i + 4));
+            }
+    }
+    compensated acc = merge_compensated(fold_lanes(s0, e0), fold_lanes(s1, e1));
+    sum_mode tailMode = mode == sum_mode::fast ? sum_mode::fast : sum_mode::neumaier;
+    return merge_compensated(acc, sum_fp_scalar(p + i, n - i, tailMode));
+}
+#endif
+
+template <typename T>
+compensated sum_fp_kernel(const T *p, size_t n, sum_mode mode) {
+#ifdef SIMD_SUM_X86
+    if (active_simd_level() >= simd_level::avx2) return sum_fp_avx2(p, n, mode);
+#endif
+    return sum_fp_scalar(p, n, mode);
+}
+
+/**
+ * Pairwise summation: halves are summed recursively, so the error grows
+ * with log(n) instead of n. Blocks below the cutoff use the vectorized
+ * plain kernel, which is itself a short tree over its lanes
+ */
+template <typename T>
+double sum_fp_pairwise(const T *p, size_t n) {
+    constexpr size_t block = 256;
+    if (n <= block) return sum_fp_kernel(p, n, sum_mode::fast).value();
+    // split on a block boundary so the leaves stay full width
+    size_t half = (n / 2 + block - 1) / block * block;
+    return sum_fp_pairwise(p, half) + sum_fp_pairwise(p + half, n - half);
+}
+
+// ---- deterministic ----------------------------------------------------
+
+/**
+ * The deterministic mode fixes every rounding step independently of how
+ * the work is split: the input is cut into blocks of this many elements
+ * (boundaries counted from the start of the array), each block is summed
+ * into 8 lanes with element i going to lane i % 8 and the lanes folded as
+ * ((0+1)+(2+3))+((4+5)+(6+7)), and the block sums are added up by a tree
+ * whose shape only depends on the number of blocks. 8 lanes are the two
+ * AVX2 registers the fast kernel already uses, so the fixed order costs
+ * next to nothing over fast
+ */
+inline constexpr size_t deterministic_block = 4096;
+
+inline double fold_lanes8(const double *l) {
+    return ((l[0] + l[1]) + (l[2] + l[3])) + ((l[4] + l[5]) + (l[6] + l[7]));
+}
+
+template <typename T>
+void add_lanes8_scalar(const T *p, size_t i, size_t n, double *lanes) {
+    for (; i + 8 <= n; i += 8) {
+        for (int l = 0; l < 8; l++) lanes[l] += (double)p[i + l];
+    }
+    for (; i < n; i++) lanes[i % 8] += (double)p[i];
+}
+
+#ifdef SIMD_SUM_X86
+template <typename T>
+SIMD_TARGET("avx2") double sum_block8_avx2(const T *p, size_t n) {
+    __m256d s0 = _mm256_setzero_pd(), s1 = s0;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        s0 = _mm256_add_pd(s0, load4_pd(p + i));
+        s1 = _mm256_add_pd(s1, load4_pd(p + i + 4));
+    }
+    alignas(32) double lanes[8];
+    _mm256_store_pd(lanes, s0);
+    _mm256_store_pd(lanes + 4, s1);
+    add_lanes8_scalar(p, i, n, lanes);
+    return fold_lanes8(lanes);
+}
+#endif
+
+// one block (or the shorter last one) in the fixed lane order
+template <typename T>
+double sum_block8(const T *p, size_t n) {
+#ifdef SIMD_SUM_X86
+    if (active_simd_level() >= simd_level::avx2) return sum_block8_avx2(p, n);
+#endif
+    double lanes[8] = {};
+    add_lanes8_scalar(p, 0, n, lanes);
+    return fold_lanes8(lanes);
+}
+
+// fixed tree over block sums: halves split at n / 2
+inline double sum_block_tree(const double *sums, size_t n) {
+    if (n == 0) return 0;
+    if (n == 1) return sums[0];
+    size_t half = n / 2;
+    return sum_block_tree(sums, half) + sum_block_tree(sums + half, n - half);
+}
+
+inline size_t deterministic_blocks(size_t n) {
+    return (n + deterministic_block - 1) / deterministic_block;
+}
+
+// sums of blocks [first, last) of p[0, n) into out[0, last - first)
+template <typename T>
+void sum_blocks8(const T *p, size_t n, size_t first, size_t last, double *out) {
+    for (size_t b = first; b < last; b++) {
+        size_t begin = b * deterministic_block;
+        out[b - first] = sum_block8(p + begin, std::min(n - begin, deterministic_block));
+    }
+}
+
+/**
+ * Sums float or double values in double precision with the given mode
+ */
+template <typename T>
+compensated sum_fp(const T *p, size_t n, sum_mode mode) {
+    if (mode == sum_mode::pairwise) return compensated{sum_fp_pairwise(p, n), 0};
+    if (mode == sum_mode::deterministic) {
+        std::vector<double> sums(deterministic_blocks(n));
+        sum_blocks8(p, n, 0, sums.size(), sums.data());
+        return compensated{sum_block_tree(sums.data(), sums.size()), 0};
+    }
+    return sum_fp_kernel(p, n, mode);
+}
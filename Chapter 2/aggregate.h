@@ -0,0 +1,129 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "reduce.h"
+
+/**
+ * Fused single-pass aggregation: any combination of sum, min, max and
+ * variance (count and mean come along for free) over one read of the
+ * input, instead of one pass per statistic. Each chunk walks its range in
+ * L1-sized blocks; a block's mean and sum of squared deviations are taken
+ * with a second sweep over the block while it is still in cache, and the
+ * block statistics are merged with Chan/Welford's parallel formula, which
+ * is also how the chunk partials are merged
+ */
+enum aggregate_flags : unsigned {
+    agg_sum = 1,
+    agg_min = 2,
+    agg_max = 4,
+    agg_variance = 8,
+    agg_all = agg_sum | agg_min | agg_max | agg_variance,
+};
+
+template <typename T>
+struct aggregates {
+    // ints sum exactly in 64 bits, floating point values in double
+    using sum_type = std::conditional_t<std::is_integral_v<T>, long long, double>;
+
+    size_t count = 0;
+    sum_type sum = 0;
+    T min = std::numeric_limits<T>::max();
+    T max = std::numeric_limits<T>::lowest();
+    double mean = 0;
+    double m2 = 0;  // sum of squared deviations from the mean
+
+    double variance() const { return count ? m2 / count : 0; }
+    double sample_variance() const { return count > 1 ? m2 / (count - 1) : 0; }
+};
+
+/**
+ * Combines the statistics of two disjoint parts of the input
+ */
+template <typename T>
+aggregates<T> merge_aggregates(const aggregates<T> &a, const aggregates<T> &b) {
+    if (a.count == 0) return b;
+    if (b.count == 0) return a;
+    aggregates<T> r;
+    r.count = a.count + b.count;
+    r.sum = a.sum + b.sum;
+    r.min = std::min(a.min, b.min);
+    r.max = std::max(a.max, b.max);
+    double delta = b.mean - a.mean;
+    double wb = (double)b.count / r.count;
+    r.mean = a.mean + delta * wb;
+    r.m2 = a.m2 + b.m2 + delta * delta * a.count * wb;
+    return r;
+}
+
+template <typename T, unsigned Flags>
+aggregates<T> aggregate_chunk(const T *p, size_t n) {
+    using sum_type = typename aggregates<T>::sum_type;
+    constexpr bool wantSum = Flags & (agg_sum | agg_variance);
+    constexpr bool wantMin = Flags & agg_min;
+    constexpr bool wantMax = Flags & agg_max;
+    constexpr bool wantVar = Flags & agg_variance;
+    constexpr size_t block = 4096 / sizeof(T);
+
+    aggregates<T> total;
+    for (size_t b = 0; b < n; b += block) {
+        size_t len = std::min(block, n - b);
+        const T *q = p + b;
+        aggregates<T> part;
+        part.count = len;
+        sum_type s = 0;
+        T lo = part.min, hi = part.max;
+        for (size_t i = 0; i < len; i++) {
+            if constexpr (wantSum) s += q[i];
+            if constexpr (wantMin) lo = std::min(lo, q[i]);
+            if constexpr (wantMax) hi = std::max(hi, q[i]);
+        }
+        part.sum = s;
+        part.min = lo;
+        part.max = hi;
+        part.mean = (double)s / len;
+        if constexpr (wantVar) {
+            // the block is still in L1, so this sweep costs no memory traffic
+            double mean = part.mean, m2 = 0;
+            for (size_t i = 0; i < len; i++) {
+                double d = (double)q[i] - mean;
+                m2 += d * d;
+            }
+            part.m2 = m2;
+        }
+        total = merge_aggregates(total, part);
+    }
+    return total;
+}
+
+template <typename T, size_t... F>
+constexpr auto aggregate_kernels(std::index_sequence<F...>) {
+    return std::array<aggregates<T> (*)(const T *, size_t), sizeof...(F)>{
+        &aggregate_chunk<T, (unsigned)F>...};
+}
+
+/**
+ * Computes the requested aggregates of arr in one pass. Statistics that
+ * weren't requested are left at their defaults; the mean is only
+ * meaningful with agg_sum or agg_variance
+ */
+template <typename T>
+aggregates<T> aggregate_vector(const std::vector<T> &arr, unsigned what = agg_all,
+                               reduce_policy policy = reduce_policy::auto_threads) {
+    static_assert(std::is_arithmetic_v<T>, "aggregate_vector needs arithmetic values");
+    // one instantiation per combination keeps the unused statistics out of
+    // the inner loop
+    static constexpr auto kernels =
+        aggregate_kernels<T>(std::make_index_sequence<agg_all + 1>());
+    auto kernel = kernels[what & agg_all];
+    const T *data = arr.data();
+    auto chunk = [data, kernel](size_t b, size_t e) { return kernel(data + b, e - b); };
+    policy.costScale *= sizeof(T) / (double)sizeof(int) * ((what & agg_variance) ? 2 : 1);
+    return reduce_chunks(arr.size(), aggregates<T>{}, chunk, merge_aggregates<T>, policy);
+}
@@ -0,0 +1,316 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "reduce.h"
+#include "thread_pool.h"
+
+/**
+ * Asynchronous reductions. Every chunk is queued on the pool as its own
+ * task and whichever task finishes last combines the partials and
+ * completes the future, so no thread (caller or worker) ever blocks
+ * waiting for the others. The caller is free to prepare the next batch
+ * and collects the result later; when_all joins several outstanding
+ * reductions into one future the same way, through completion callbacks.
+ *
+ * The input must outlive the reduction. Don't block on these futures from
+ * inside a pool task: the pool may need that worker to finish the chunks
+ */
+template <typename T>
+class reduce_future;
+
+template <typename T>
+class reduce_promise;
+
+template <typename T>
+struct future_state {
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = false;
+    std::optional<T> value;
+    std::exception_ptr error;
+    std::vector<std::function<void()>> continuations;
+
+    // callbacks run outside the lock, on the thread that completes the state
+    void finish(std::unique_lock<std::mutex> &lock) {
+        done = true;
+        auto pending = std::move(continuations);
+        lock.unlock();
+        cv.notify_all();
+        for (auto &c : pending) c();
+    }
+};
+
+template <typename T>
+class reduce_future {
+   private:
+    std::shared_ptr<future_state<T>> state;
+
+    friend class reduce_promise<T>;
+    template <typename U>
+    friend reduce_future<std::vector<U>> when_all(std::vector<reduce_future<U>> &futures);
+
+    explicit reduce_future(std::shared_ptr<future_state<T>> s) : state(std::move(s)) {}
+
+    /**
+     * Runs fn once the result is in, right away if it already is
+     */
+    void on_ready(std::function<void()> fn) {
+        std::unique_lock<std::mutex> lock(state->m);
+        if (!state->done) {
+            state->continuations.push_back(std::move(fn));
+            return;
+        }
+        lock.unlock();
+        fn();
+    }
+
+   public:
+    reduce_future() {}
+
+    bool valid() const { return state != nullptr; }
+
+    bool is_ready() const {
+        if (!state) throw std::logic_error("no state");
+        std::lock_guard<std::mutex> lock(state->m);
+        return state->done;
+    }
+
+    void wait() const {
+        if (!state) throw std::logic_error("no state");
+        std::unique_lock<std::mutex> lock(state->m);
+        state->cv.wait(lock, [this] { return state->done; });
+    }
+
+    template <typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period> &timeout) const {
+        if (!state) throw std::logic_error("no state");
+        std::unique_lock<std::mutex> lock(state->m);
+        return state->cv.wait_for(lock, timeout, [this] { return state->done; });
+    }
+
+    /**
+     * Future for fn(result), run by whichever thread completes this one.
+     * Consumes this future; exceptions skip fn and pass straight through
+     */
+    template <typename F>
+    auto then(F fn) -> reduce_future<decltype(fn(std::declval<T>()))> {
+        using U = decltype(fn(std::declval<T>()));
+        if (!state) throw std::logic_error("no state");
+        auto next = std::make_shared<reduce_promise<U>>();
+        reduce_future<U> result = next->get_future();
+        auto s = state;
+        on_ready([s, next, fn = std::move(fn)]() mutable {
+            if (s->error) {
+                next->set_exception(s->error);
+                return;
+            }
+            try {
+                next->set_value(fn(std::move(*s->value)));
+            } catch (...) {
+                next->set_exception(std::current_exception());
+            }
+        });
+        state.reset();
+        return result;
+    }
+
+    /**
+     * Waits for and takes the result, rethrowing whatever the reduction
+     * threw. Like std::future, the future is no longer valid afterwards
+     */
+    T get() {
+        wait();
+        auto s = std::move(state);
+        if (s->error) std::rethrow_exception(s->error);
+        return std::move(*s->value);
+    }
+};
+
+template <typename T>
+class reduce_promise {
+   private:
+    std::shared_ptr<future_state<T>> state = std::make_shared<future_state<T>>();
+
+   public:
+    reduce_future<T> get_future() { return reduce_future<T>(state); }
+
+    void set_value(T value) {
+        std::unique_lock<std::mutex> lock(state->m);
+        if (state->done) throw std::logic_error("promise already satisfied");
+        state->value = std::move(value);
+        state->finish(lock);
+    }
+
+    void set_exception(std::exception_ptr e) {
+        std::unique_lock<std::mutex> lock(state->m);
+        if (state->done) throw std::logic_error("promise already satisfied");
+        state->error = e;
+        state->finish(lock);
+    }
+};
+
+/**
+ * Future for the results of all the given reductions, in order. Fails with
+ * the first failing reduction's exception. The inputs are consumed
+ */
+template <typename T>
+reduce_future<std::vector<T>> when_all(std::vector<reduce_future<T>> &futures) {
+    struct join {
+        std::vector<std::optional<T>> results;
+        std::atomic<size_t> remaining;
+        std::mutex m;
+        std::exception_ptr error;
+        reduce_promise<std::vector<T>> promise;
+
+        explicit join(size_t n) : results(n), remaining(n) {}
+    };
+    for (const auto &f : futures) {
+        if (!f.valid()) throw std::logic_error("when_all given an invalid future");
+    }
+    auto j = std::make_shared<join>(futures.size());
+    reduce_future<std::vector<T>> all = j->promise.get_future();
+    if (futures.empty()) {
+        j->promise.set_value({});
+        return all;
+    }
+    for (size_t i = 0; i < futures.size(); i++) {
+        auto s = std::move(futures[i].state);
+        reduce_future<T> f(s);
+        f.on_ready([j, s, i] {
+            if (s->error) {
+                std::lock_guard<std::mutex> lock(j->m);
+                if (!j->error) j->error = s->error;
+            } else {
+                j->results[i] = std::move(*s->value);
+            }
+            if (j->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            if (j->error) {
+                j->promise.set_exception(j->error);
+                return;
+            }
+            std::vector<T> values;
+            values.reserve(j->results.size());
+            for (auto &r : j->results) values.push_back(std::move(*r));
+            j->promise.set_value(std::move(values));
+        });
+    }
+    return all;
+}
+
+template <typename T>
+reduce_future<std::vector<T>> when_all(std::vector<reduce_future<T>> &&futures) {
+    return when_all(futures);
+}
+
+/**
+ * Asynchronous reduce_chunks: fn and combine are copied, since they run
+ * after this call returns
+ */
+template <typename T, typename ChunkFn, typename Combine>
+reduce_future<T> reduce_chunks_async(size_t n, T identity, ChunkFn fn, Combine combine,
+                                     reduce_policy policy = reduce_policy::auto_threads) {
+    struct job {
+        T identity;
+        ChunkFn fn;
+        Combine combine;
+        std::vector<std::pair<size_t, size_t>> chunks;
+        std::vector<padded<T>> partials;
+        std::atomic<size_t> remaining;
+        std::mutex m;
+        std::exception_ptr error;
+        reduce_promise<T> promise;
+
+        job(T id, ChunkFn f, Combine c, std::vector<std::pair<size_t, size_t>> ch)
+            : identity(id), fn(std::move(f)), combine(std::move(c)), chunks(std::move(ch)),
+              partials(chunks.size(), padded<T>{id}), remaining(chunks.size()) {}
+
+        void run(size_t c) {
+            try {
+                partials[c].value = fn(chunks[c].first, chunks[c].second);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m);
+                if (!error) error = std::current_exception();
+            }
+            if (remaining.fetch_sub(1, std::memory_order_acq_rel) != 1) return;
+            // last chunk in: the partials are all visible through the
+            // acquire above
+            if (error) {
+                promise.set_exception(error);
+                return;
+            }
+            try {
+                T total = identity;
+                for (const auto &p : partials) total = combine(total, p.value);
+                promise.set_value(std::move(total));
+            } catch (...) {
+                promise.set_exception(std::current_exception());
+            }
+        }
+    };
+
+    policy = resolve_policy(n, policy);
+    auto j = std::make_shared<job>(identity, std::move(fn), std::move(combine),
+                                   policy_chunks(n, policy));
+    reduce_future<T> result = j->promise.get_future();
+    if (j->chunks.empty()) {
+        j->promise.set_value(identity);
+        return result;
+    }
+    thread_pool &pool = default_pool();
+    for (size_t c = 0; c < j->chunks.size(); c++) {
+        pool.submit([j, c] { j->run(c); });
+    }
+    return result;
+}
+
+/**
+ * Starts summing arr on the pool and returns immediately. arr must stay
+ * alive and unmodified until the future is ready
+ */
+inline reduce_future<int> sum_vector_async(const std::vector<int> &arr,
+                                           reduce_policy policy = reduce_policy::auto_threads) {
+    const int *data = arr.data();
+    auto chunk = [data](size_t b, size_t e) { return sum_int(data + b, e - b); };
+    return reduce_chunks_async(arr.size(), 0, chunk, wrapping_plus(), policy);
+}
+
+inline reduce_future<double> sum_vector_async(const std::vector<double> &arr,
+                                              reduce_policy policy = reduce_policy::auto_threads,
+                                              sum_mode mode = sum_mode::neumaier) {
+    const double *data = arr.data();
+    if (mode == sum_mode::deterministic) {
+        // chunks hand back the sums of the blocks starting inside them,
+        // concatenated in order for the fixed tree
+        size_t n = arr.size();
+        auto blocks = [data, n](size_t b, size_t e) {
+            size_t first = deterministic_blocks(b), last = deterministic_blocks(e);
+            std::vector<double> sums(last - first);
+            sum_blocks8(data, n, first, last, sums.data());
+            return sums;
+        };
+        auto concat = [](std::vector<double> a, const std::vector<double> &b) {
+            a.insert(a.end(), b.begin(), b.end());
+            return a;
+        };
+        policy.costScale *= 2;
+        auto tree = [](std::vector<double> sums) {
+            return sum_block_tree(sums.data(), sums.size());
+        };
+        return reduce_chunks_async(n, std::vector<double>(), blocks, concat, policy).then(tree);
+    }
+    auto chunk = [data, mode](size_t b, size_t e) { return sum_fp(data + b, e - b, mode); };
+    policy.costScale *= mode == sum_mode::fast ? 2 : 4;
+    return reduce_chunks_async(arr.size(), compensated{}, chunk, merge_compensated, policy)
+        .then([](compensated c) { return c.value(); });
+}
@@ -0,0 +1,52 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "batch_sum.h"
+#include "reduce.h"
+#include "timing.h"
+
+/**
+ * Many small arrays reduced three ways: sum_vector on each one, a single
+ * batched sum_vectors dispatch, and sum_vector over their concatenation,
+ * which is the cost the batch should approach.
+ *
+ * usage: batch_bench [arrays] [max_array_size] [threads]
+ */
+int main(int argc, char **argv) {
+    size_t count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 500;
+    size_t maxSize = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+    reduce_policy policy = argc > 3 ? reduce_policy(std::atoi(argv[3]))
+                                    : reduce_policy(reduce_policy::auto_threads);
+
+    // sizes vary from tiny to maxSize so chunks straddle arrays
+    std::vector<std::vector<int>> arrays;
+    std::vector<int> concatenated;
+    for (size_t a = 0; a < count; a++) {
+        size_t size = (a * 7919) % (maxSize + 1);
+        arrays.emplace_back(size, (int)(a % 5));
+        concatenated.insert(concatenated.end(), arrays.back().begin(), arrays.back().end());
+    }
+
+    std::vector<int> each(count), batched;
+    int whole = 0;
+    double eachTime = 1e6 * best_seconds(20, [&] {
+        for (size_t a = 0; a < count; a++) each[a] = sum_vector(arrays[a], policy);
+    });
+    double batchTime = 1e6 * best_seconds(20, [&] { batched = sum_vectors(arrays, policy); });
+    double wholeTime = 1e6 * best_seconds(20, [&] { whole = sum_vector(concatenated, policy); });
+
+    int batchedTotal = 0;
+    for (int s : batched) batchedTotal += s;
+    bool ok = batched == each && batchedTotal == whole;
+
+    std::cout << count << " arrays, " << concatenated.size() << " elements in total"
+              << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "sum_vector per array: " << eachTime << " us" << std::endl;
+    std::cout << "sum_vectors batch:    " << batchTime << " us" << std::endl;
+    std::cout << "concatenation:        " << wholeTime << " us" << std::endl;
+    std::cout << "Correct: " << (ok ? "Yes" : "No") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "reduce.h"
+#include "thread_pool.h"
+
+/**
+ * Reduces many arrays in a single pool dispatch. The arrays are treated as
+ * one virtual concatenation which is chunked like a single sum_vector
+ * input, so hundreds of small arrays share one set of chunks (and one
+ * fork/join) and the cost tracks reducing their concatenation. A chunk
+ * writes the results of arrays it covers entirely; the arrays cut by chunk
+ * boundaries get their pieces combined, in order, afterwards
+ */
+template <typename T>
+struct array_view {
+    const T *data;
+    size_t size;
+};
+
+template <typename T, typename R, typename KernelFn, typename Combine>
+std::vector<R> reduce_batch(const std::vector<array_view<T>> &arrays, R identity,
+                            const KernelFn &kernel, Combine combine,
+                            reduce_policy policy = reduce_policy::auto_threads) {
+    std::vector<R> out(arrays.size(), identity);
+    // offsets[a] is where array a starts in the concatenation
+    std::vector<size_t> offsets(arrays.size() + 1, 0);
+    for (size_t a = 0; a < arrays.size(); a++) offsets[a + 1] = offsets[a] + arrays[a].size;
+    size_t total = offsets.back();
+    if (total == 0) return out;
+
+    policy = resolve_policy(total, policy);
+    auto chunks = policy_chunks(total, policy);
+    struct piece {
+        size_t array;
+        R value;
+    };
+    std::vector<std::vector<piece>> pieces(chunks.size());
+
+    default_pool().parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            size_t b = chunks[c].first, e = chunks[c].second;
+            // first array with data at or after b (skips empty arrays)
+            size_t a = std::upper_bound(offsets.begin(), offsets.end(), b) - offsets.begin() - 1;
+            for (; a < arrays.size() && offsets[a] < e; a++) {
+                size_t from = std::max(b, offsets[a]), to = std::min(e, offsets[a + 1]);
+                if (from >= to) continue;
+                R value = kernel(arrays[a].data + (from - offsets[a]), to - from);
+                if (from == offsets[a] && to == offsets[a + 1]) {
+                    out[a] = value;
+                } else {
+                    pieces[c].push_back({a, value});
+                }
+            }
+        },
+        policy.numThreads);
+
+    for (const auto &chunkPieces : pieces) {
+        for (const piece &p : chunkPieces) out[p.array] = combine(out[p.array], p.value);
+    }
+    return out;
+}
+
+template <typename T>
+std::vector<array_view<T>> views_of(const std::vector<std::vector<T>> &arrays) {
+    std::vector<array_view<T>> views;
+    views.reserve(arrays.size());
+    for (const auto &a : arrays) views.push_back({a.data(), a.size()});
+    return views;
+}
+
+/**
+ * One sum per array, like calling sum_vector on each but in one dispatch
+ */
+inline std::vector<int> sum_vectors(const std::vector<std::vector<int>> &arrays,
+                                    reduce_policy policy = reduce_policy::auto_threads) {
+    return reduce_batch(views_of(arrays), 0, sum_int, wrapping_plus(), policy);
+}
+
+inline std::vector<long long> sum_vectors_wide(const std::vector<std::vector<int>> &arrays,
+                                               reduce_policy policy = reduce_policy::auto_threads) {
+    return reduce_batch(views_of(arrays), 0LL, sum_int_wide, std::plus<long long>(), policy);
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include "reduce.h"
+#include "simd_sum.h"
+#include "thread_pool.h"
+
+/**
+ * BLAS level 1 kernels on double vectors with the sum_vector machinery:
+ * dot and norm2 are reductions through reduce_chunks, axpy and scale
+ * update their chunks in place on the same pool. Every op has a fused
+ * AVX2 inner loop (load, multiply, add and store in one pass, four
+ * independent accumulators for the reductions) and a scalar fallback.
+ * The cost scales tell the auto policy how many bytes an element moves
+ * relative to sum_vector's one int
+ */
+inline void check_same_size(size_t a, size_t b) {
+    if (a != b) throw std::invalid_argument("vectors differ in size");
+}
+
+inline double dot_scalar(const double *x, const double *y, size_t n) {
+    double a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 += x[i] * y[i];
+        a1 += x[i + 1] * y[i + 1];
+        a2 += x[i + 2] * y[i + 2];
+        a3 += x[i + 3] * y[i + 3];
+    }
+    for (; i < n; i++) a0 += x[i] * y[i];
+    return (a0 + a1) + (a2 + a3);
+}
+
+inline void axpy_scalar(double a, const double *x, double *y, size_t n) {
+    for (size_t i = 0; i < n; i++) y[i] += a * x[i];
+}
+
+inline void scale_scalar(double a, double *x, size_t n) {
+    for (size_t i = 0; i < n; i++) x[i] *= a;
+}
+
+#ifdef SIMD_SUM_X86
+SIMD_TARGET("avx2") inline double hsum_pd(__m256d v) {
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+}
+
+SIMD_TARGET("avx2") inline double dot_avx2(const double *x, const double *y, size_t n) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = a0, a2 = a0, a3 = a0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        a0 = _mm256_add_pd(a0, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+        a1 = _mm256_add_pd(a1,
+                           _mm256_mul_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+        a2 = _mm256_add_pd(a2,
+                           _mm256_mul_pd(_mm256_loadu_pd(x + i + 8), _mm256_loadu_pd(y + i + 8)));
+        a3 = _mm256_add_pd(
+            a3, _mm256_mul_pd(_mm256_loadu_pd(x + i + 12), _mm256_loadu_pd(y + i + 12)));
+    }
+    __m256d acc = _mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3));
+    return hsum_pd(acc) + dot_scalar(x + i, y + i, n - i);
+}
+
+SIMD_TARGET("avx2") inline void axpy_avx2(double a, const double *x, double *y, size_t n) {
+    __m256d va = _mm256_set1_pd(a);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d y0 =
+            _mm256_add_pd(_mm256_loadu_pd(y + i), _mm256_mul_pd(va, _mm256_loadu_pd(x + i)));
+        __m256d y1 = _mm256_add_pd(_mm256_loadu_pd(y + i + 4),
+                                   _mm256_mul_pd(va, _mm256_loadu_pd(x + i + 4)));
+        _mm256_storeu_pd(y + i, y0);
+        _mm256_storeu_pd(y + i + 4, y1);
+    }
+    axpy_scalar(a, x + i, y + i, n - i);
+}
+
+SIMD_TARGET("avx2") inline void scale_avx2(double a, double *x, size_t n) {
+    __m256d va = _mm256_set1_pd(a);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        _mm256_storeu_pd(x + i, _mm256_mul_pd(va, _mm256_loadu_pd(x + i)));
+        _mm256_storeu_pd(x + i + 4, _mm256_mul_pd(va, _mm256_loadu_pd(x + i + 4)));
+    }
+    scale_scalar(a, x + i, n - i);
+}
+#endif
+
+inline double dot_kernel(const double *x, const double *y, size_t n) {
+#ifdef SIMD_SUM_X86
+    if (active_simd_level() >= simd_level::avx2) return dot_avx2(x, y, n);
+#endif
+    return dot_scalar(x, y, n);
+}
+
+inline void axpy_kernel(double a, const double *x, double *y, size_t n) {
+#ifdef SIMD_SUM_X86
+    if (active_simd_level() >= simd_level::avx2) return axpy_avx2(a, x, y, n);
+#endif
+    axpy_scalar(a, x, y, n);
+}
+
+inline void scale_kernel(double a, double *x, size_t n) {
+#ifdef SIMD_SUM_X86
+    if (active_simd_level() >= simd_level::avx2) return scale_avx2(a, x, n);
+#endif
+    scale_scalar(a, x, n);
+}
+
+/**
+ * Sum of x[i] * y[i]
+ */
+inline double dot(const std::vector<double> &x, const std::vector<double> &y,
+                  reduce_policy policy = reduce_policy::auto_threads) {
+    check_same_size(x.size(), y.size());
+    const double *px = x.data(), *py = y.data();
+    auto chunk = [px, py](size_t b, size_t e) { return dot_kernel(px + b, py + b, e - b); };
+    policy.costScale *= 4;
+    return reduce_chunks(x.size(), 0.0, chunk, std::plus<double>(), policy);
+}
+
+/**
+ * y = a * x + y
+ */
+inline void axpy(double a, const std::vector<double> &x, std::vector<double> &y,
+                 reduce_policy policy = reduce_policy::auto_threads) {
+    check_same_size(x.size(), y.size());
+    const double *px = x.data();
+    double *py = y.data();
+    policy.costScale *= 6;
+    for_each_chunk(
+        x.size(), [a, px, py](size_t b, size_t e) { axpy_kernel(a, px + b, py + b, e - b); },
+        policy);
+}
+
+/**
+ * x = a * x
+ */
+inline void scale(double a, std::vector<double> &x,
+                  reduce_policy policy = reduce_policy::auto_threads) {
+    double *px = x.data();
+    policy.costScale *= 4;
+    for_each_chunk(
+        x.size(), [a, px](size_t b, size_t e) { scale_kernel(a, px + b, e - b); }, policy);
+}
+
+/**
+ * Euclidean norm. Squares are summed directly, so inputs near the square
+ * root of the double range overflow
+ */
+inline double norm2(const std::vector<double> &x,
+                    reduce_policy policy = reduce_policy::auto_threads) {
+    const double *px = x.data();
+    auto chunk = [px](size_t b, size_t e) { return dot_kernel(px + b, px + b, e - b); };
+    policy.costScale *= 2;
+    return std::sqrt(reduce_chunks(x.size(), 0.0, chunk, std::plus<double>(), policy));
+}
@@ -0,0 +1,88 @@
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "blas1.h"
+#include "timing.h"
+
+/**
+ * dot, axpy, scale and norm2 on the pool against naive single threaded
+ * loops, in GB/s of memory traffic (bytes read plus bytes written).
+ *
+ * usage: blas_bench [elements] [threads]
+ */
+bool close(double a, double b) { return std::abs(a - b) <= 1e-9 * std::max(1.0, std::abs(b)); }
+
+// element-wise, as FMA contraction (e.g. -march=native) may round the two
+// loops differently
+bool all_close(const std::vector<double> &a, const std::vector<double> &b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (!close(a[i], b[i])) return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (size_t)1 << 24;
+    reduce_policy policy = argc > 2 ? reduce_policy(std::atoi(argv[2]))
+                                    : reduce_policy(reduce_policy::auto_threads);
+
+    std::vector<double> x(n), y(n);
+    for (size_t i = 0; i < n; i++) {
+        x[i] = (double)(i % 13) * 0.5;
+        y[i] = 1.0 - (double)(i % 7) * 0.25;
+    }
+
+    bool ok = true;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(8) << "op" << std::setw(14) << "naive GB/s" << std::setw(14)
+              << "pool GB/s" << std::endl;
+    auto report = [&](const std::string &op, double bytes, double naive, double pooled) {
+        std::cout << std::setw(8) << op << std::setw(14) << bytes / naive / 1e9 << std::setw(14)
+                  << bytes / pooled / 1e9 << std::endl;
+    };
+
+    double naiveDot = 0, poolDot = 0;
+    double t0 = best_seconds(5, [&] {
+        double acc = 0;
+        for (size_t i = 0; i < n; i++) acc += x[i] * y[i];
+        naiveDot = acc;
+    });
+    double t1 = best_seconds(5, [&] { poolDot = dot(x, y, policy); });
+    ok = ok && close(poolDot, naiveDot);
+    report("dot", 16.0 * n, t0, t1);
+
+    double naiveNorm = 0, poolNorm = 0;
+    t0 = best_seconds(5, [&] {
+        double acc = 0;
+        for (size_t i = 0; i < n; i++) acc += x[i] * x[i];
+        naiveNorm = std::sqrt(acc);
+    });
+    t1 = best_seconds(5, [&] { poolNorm = norm2(x, policy); });
+    ok = ok && close(poolNorm, naiveNorm);
+    report("norm2", 8.0 * n, t0, t1);
+
+    // axpy and scale run 5 times each, with factors that keep values bounded
+    std::vector<double> naiveY = y, poolY = y;
+    t0 = best_seconds(5, [&] {
+        for (size_t i = 0; i < n; i++) naiveY[i] += 0.5 * x[i];
+    });
+    t1 = best_seconds(5, [&] { axpy(0.5, x, poolY, policy); });
+    ok = ok && all_close(poolY, naiveY);
+    report("axpy", 24.0 * n, t0, t1);
+
+    std::vector<double> naiveX = x, poolX = x;
+    t0 = best_seconds(5, [&] {
+        for (size_t i = 0; i < n; i++) naiveX[i] *= 1.5;
+    });
+    t1 = best_seconds(5, [&] { scale(1.5, poolX, policy); });
+    ok = ok && all_close(poolX, naiveX);
+    report("scale", 16.0 * n, t0, t1);
+
+    std::cout << "Correct: " << (ok ? "Yes" : "No") << std::endl;
+    return ok ? 0 : 1;
+}
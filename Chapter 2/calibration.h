@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simd_sum.h"
+#include "thread_pool.h"
+#include "timing.h"
+
+/**
+ * Machine costs the automatic reduction policy is derived from. They are
+ * measured once per machine and persisted, so later processes start
+ * without paying for the measurement again
+ */
+struct reduce_calibration {
+    double elementNanos = 0.25;    // single thread int sum cost per element
+    double dispatchMicros = 20.0;  // fork/join of the whole default pool
+    unsigned hardwareThreads = 0;  // calibration is redone if this changes
+};
+
+/**
+ * $REDUCE_CALIBRATION if set, otherwise a file in the XDG cache directory
+ */
+inline std::string calibration_path() {
+    if (const char *p = std::getenv("REDUCE_CALIBRATION")) return p;
+    const std::string name = "reduce_calibration";
+    if (const char *p = std::getenv("XDG_CACHE_HOME")) return std::string(p) + "/" + name;
+    if (const char *p = std::getenv("HOME")) return std::string(p) + "/.cache/" + name;
+    return name;
+}
+
+inline bool load_calibration(const std::string &path, reduce_calibration &cal) {
+    std::ifstream in(path);
+    reduce_calibration loaded;
+    if (!(in >> loaded.elementNanos >> loaded.dispatchMicros >> loaded.hardwareThreads)) {
+        return false;
+    }
+    if (loaded.hardwareThreads != std::thread::hardware_concurrency()) return false;
+    if (loaded.elementNanos <= 0 || loaded.dispatchMicros <= 0) return false;
+    cal = loaded;
+    return true;
+}
+
+// best effort: a read-only cache just means calibrating in every process
+inline void save_calibration(const std::string &path, const reduce_calibration &cal) {
+    std::ofstream out(path);
+    out << cal.elementNanos << " " << cal.dispatchMicros << " " << cal.hardwareThreads << "\n";
+}
+
+/**
+ * Times the int sum kernel on an L2-sized buffer, then the same work split
+ * across every thread a pool loop may use; whatever the split doesn't save
+ * is dispatch overhead. Takes a few milliseconds
+ */
+inline reduce_calibration measure_calibration() {
+    reduce_calibration cal;
+    cal.hardwareThreads = std::thread::hardware_concurrency();
+
+    const size_t n = (size_t)1 << 18;
+    std::vector<int> data(n, 1);
+    volatile int sink = 0;
+    double seq = median_seconds(31, [&] { sink = sum_int(data.data(), data.size()); });
+    cal.elementNanos = std::max(seq * 1e9 / n, 0.01);
+
+    thread_pool &pool = default_pool();
+    size_t parts = (size_t)default_parallelism();
+    size_t part = n / parts;
+    std::vector<int> partials(parts * 16);
+    double par = median_seconds(31, [&] {
+        pool.parallel_for(parts, [&](size_t i) {
+            partials[i * 16] = sum_int(data.data() + i * part, part);
+        });
+    });
+    (void)sink;
+    cal.dispatchMicros = std::max((par - seq / parts) * 1e6, 1.0);
+    return cal;
+}
+
+/**
+ * Calibration for this machine: loaded from calibration_path() when a
+ * matching one was saved, otherwise measured on first use and saved
+ */
+inline const reduce_calibration &calibration() {
+    static reduce_calibration cal = [] {
+        reduce_calibration c;
+        std::string path = calibration_path();
+        if (!load_calibration(path, c)) {
+            c = measure_calibration();
+            save_calibration(path, c);
+        }
+        return c;
+    }();
+    return cal;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "reduce.h"
+#include "scan.h"
+#include "thread_pool.h"
+
+/**
+ * Fenwick (binary indexed) tree over ints for workloads that change a few
+ * elements between sum queries: point updates and range sums are
+ * O(log n) instead of a full sum_vector rescan. Every node is an atomic
+ * updated with fetch_add, so any number of threads can update and query
+ * at once without locks; a query running concurrently with updates sees
+ * each of them either fully or not at all per node, and once updates
+ * quiesce every query is exact. Sums wrap on overflow exactly like
+ * sum_vector, so results are bit-identical to a recompute
+ */
+class concurrent_fenwick {
+   private:
+    std::vector<std::atomic<int>> values;
+    std::vector<std::atomic<int>> tree;  // 1-based, tree[i] covers (i - lowbit(i), i]
+
+    static size_t lowbit(size_t i) { return i & (~i + 1); }
+
+    void add_to_tree(size_t i, int delta) {
+        for (size_t j = i + 1; j < tree.size(); j += lowbit(j)) {
+            tree[j].fetch_add(delta, std::memory_order_relaxed);
+        }
+    }
+
+   public:
+    /**
+     * Builds in O(n) and in parallel: node i is P[i] - P[i - lowbit(i)] for
+     * the prefix sums P, which come from the parallel scan
+     */
+    explicit concurrent_fenwick(const std::vector<int> &init,
+                                reduce_policy policy = reduce_policy::auto_threads)
+        : values(init.size()), tree(init.size() + 1) {
+        size_t n = init.size();
+        std::vector<int> prefix(n + 1, 0);
+        parallel_scan(init.data(), prefix.data() + 1, n, 0, false, policy);
+        policy = resolve_policy(n, policy);
+        auto chunks = partition_range(n, policy.numThreads, policy.grain);
+        default_pool().parallel_for(
+            chunks.size(),
+            [&](size_t c) {
+                for (size_t i = chunks[c].first; i < chunks[c].second; i++) {
+                    size_t node = i + 1;
+                    unsigned diff = (unsigned)prefix[node] - (unsigned)prefix[node - lowbit(node)];
+                    tree[node].store((int)diff, std::memory_order_relaxed);
+                    values[i].store(init[i], std::memory_order_relaxed);
+                }
+            },
+            policy.numThreads);
+        tree[0].store(0, std::memory_order_relaxed);
+    }
+
+    concurrent_fenwick(const concurrent_fenwick &) = delete;
+    concurrent_fenwick &operator=(const concurrent_fenwick &) = delete;
+
+    size_t size() const { return values.size(); }
+
+    void add(size_t i, int delta) {
+        if (i >= size()) throw std::out_of_range("fenwick index out of range");
+        values[i].fetch_add(delta, std::memory_order_relaxed);
+        add_to_tree(i, delta);
+    }
+
+    /**
+     * Stores value at i. The exchange makes racing sets of the same
+     * element each apply the difference to the value they replaced
+     */
+    void set(size_t i, int value) {
+        if (i >= size()) throw std::out_of_range("fenwick index out of range");
+        int old = values[i].exchange(value, std::memory_order_relaxed);
+        add_to_tree(i, (int)((unsigned)value - (unsigned)old));
+    }
+
+    int get(size_t i) const { return values.at(i).load(std::memory_order_relaxed); }
+
+    // sum of [0, n)
+    int prefix_sum(size_t n) const {
+        if (n > size()) throw std::out_of_range("fenwick prefix past end");
+        unsigned acc = 0;
+        for (size_t j = n; j > 0; j -= lowbit(j)) {
+            acc += (unsigned)tree[j].load(std::memory_order_relaxed);
+        }
+        return (int)acc;
+    }
+
+    // sum of [first, last)
+    int range_sum(size_t first, size_t last) const {
+        if (first > last) throw std::invalid_argument("fenwick range is reversed");
+        return (int)((unsigned)prefix_sum(last) - (unsigned)prefix_sum(first));
+    }
+
+    int total() const { return prefix_sum(size()); }
+};
@@ -0,0 +1,88 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "file_sum.h"
+#include "timing.h"
+
+/**
+ * Writes a file of the given number of int32 values (or takes an existing
+ * file of them) and sums it through the mmap and pread front-ends,
+ * reporting GB/s. A second run measures page cache bandwidth; drop the
+ * caches between runs to measure the disk. Small int64 and double files
+ * check the other element types and the length-prefixed format.
+ *
+ * usage: file_bench [elements | path]
+ */
+template <typename T>
+void write_values(const std::string &path, const std::vector<T> &values, bool prefixed) {
+    std::ofstream out(path, std::ios::binary);
+    if (prefixed) {
+        uint64_t count = values.size();
+        out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    }
+    out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+}
+
+int main(int argc, char **argv) {
+    // a number is the element count of a generated file, anything else a path
+    std::string arg = argc > 1 ? argv[1] : "";
+    bool generated = arg.find_first_not_of("0123456789") == std::string::npos;
+    size_t n = !arg.empty() && generated ? std::strtoull(arg.c_str(), nullptr, 10)
+                                         : (size_t)1 << 28;
+    std::string path = generated ? "/tmp/file_bench.i32" : arg;
+
+    long long expected = 0;
+    if (generated) {
+        // written in blocks so the generator never holds the whole file either
+        std::ofstream out(path, std::ios::binary);
+        std::vector<int32_t> block(1 << 20);
+        for (size_t i = 0; i < n; i += block.size()) {
+            size_t m = std::min(block.size(), n - i);
+            for (size_t j = 0; j < m; j++) {
+                block[j] = (int32_t)((i + j) % 1000) - 500;
+                expected += block[j];
+            }
+            out.write(reinterpret_cast<const char *>(block.data()), m * sizeof(int32_t));
+        }
+    } else {
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in) {
+            std::cerr << "cannot open " << path << std::endl;
+            return 1;
+        }
+        n = (size_t)in.tellg() / sizeof(int32_t);
+    }
+
+    bool ok = true;
+    std::cout << std::fixed << std::setprecision(2);
+    for (file_access access : {file_access::mmap, file_access::stream}) {
+        const char *name = access == file_access::mmap ? "mmap  " : "stream";
+        long long sum = 0;
+        double t = time_seconds([&] { sum = sum_file<int32_t>(path, file_format::raw, access); });
+        double gb = (double)n * sizeof(int32_t) / 1e9;
+        std::cout << name << ": " << sum << " at " << gb / t << " GB/s" << std::endl;
+        if (generated) ok = ok && sum == expected;
+    }
+    if (generated) std::remove(path.c_str());
+
+    std::vector<int64_t> big(100000, (int64_t)1 << 62);
+    std::vector<double> fp(100001, 0.1);
+    write_values("/tmp/file_bench.i64", big, true);
+    write_values("/tmp/file_bench.f64", fp, true);
+    for (file_access access : {file_access::mmap, file_access::stream}) {
+        int128 s = sum_file<int64_t>("/tmp/file_bench.i64", file_format::length_prefixed, access);
+        double d = sum_file<double>("/tmp/file_bench.f64", file_format::length_prefixed, access);
+        ok = ok && s == (int128)100000 * ((int64_t)1 << 62) && std::abs(d - 10000.1) < 1e-9;
+    }
+    std::remove("/tmp/file_bench.i64");
+    std::remove("/tmp/file_bench.f64");
+
+    std::cout << "Correct: " << (ok ? "Yes" : "No") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "accurate_sum.h"
+#include "async_reduce.h"
+#include "reduce.h"
+
+/**
+ * Sums binary files of int32, int64 or double values without ever holding
+ * the whole file: the file is walked one window at a time and every window
+ * is reduced by the pool like a sum_vector input.
+ *   - file_access::mmap maps the file with a sequential hint, asks the
+ *     kernel to prefetch the next window while the current one is reduced
+ *     and drops each window's pages from the mapping once it is done
+ *   - file_access::stream double buffers pread: the next window is read
+ *     into one buffer while the pool reduces the other asynchronously
+ * Files are either raw values or length-prefixed: a native-endian uint64
+ * element count followed by the values
+ */
+enum class file_format { raw, length_prefixed };
+enum class file_access { mmap, stream };
+
+inline constexpr size_t file_window_bytes = (size_t)64 << 20;
+
+// err defaults to errno; read it before any cleanup call can change it
+inline std::runtime_error file_error(const std::string &what, const std::string &path,
+                                     int err = errno) {
+    return std::runtime_error(what + " " + path + ": " + std::strerror(err));
+}
+
+/**
+ * Accumulator and kernel used for each element type: ints widen so
+ * multi-GB files can't overflow, doubles carry a Neumaier error term
+ */
+template <typename T>
+struct file_sum_traits;
+
+template <>
+struct file_sum_traits<int32_t> {
+    using acc = long long;
+    using result = long long;
+    static acc chunk(const int32_t *p, size_t n) { return sum_int_wide(p, n); }
+    static acc combine(acc a, acc b) { return a + b; }
+    static result finish(acc a) { return a; }
+    static constexpr double cost = 1;
+};
+
+#ifdef __SIZEOF_INT128__
+template <>
+struct file_sum_traits<int64_t> {
+    using acc = int128;
+    using result = int128;
+    static acc chunk(const int64_t *p, size_t n) {
+        return sum_int64_wide(reinterpret_cast<const long long *>(p), n);
+    }
+    static acc combine(acc a, acc b) { return a + b; }
+    static result finish(acc a) { return a; }
+    static constexpr double cost = 2;
+};
+#endif
+
+template <>
+struct file_sum_traits<double> {
+    using acc = compensated;
+    using result = double;
+    static acc chunk(const double *p, size_t n) { return sum_fp(p, n, sum_mode::neumaier); }
+    static acc combine(acc a, const acc &b) { return merge_compensated(a, b); }
+    static result finish(acc a) { return a.value(); }
+    static constexpr double cost = 4;
+};
+
+/**
+ * Read-only private mapping of a whole file, unmapped on destruction
+ */
+class mapped_file {
+   private:
+    int fd = -1;
+    void *base = MAP_FAILED;
+    size_t length = 0;
+
+   public:
+    explicit mapped_file(const std::string &path) {
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) throw file_error("cannot open", path);
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int err = errno;
+            ::close(fd);
+            throw file_error("cannot stat", path, err);
+        }
+        length = (size_t)st.st_size;
+        if (length == 0) return;
+        base = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (base == MAP_FAILED) {
+            int err = errno;
+            ::close(fd);
+            throw file_error("cannot map", path, err);
+        }
+        ::madvise(base, length, MADV_SEQUENTIAL);
+    }
+
+    ~mapped_file() {
+        if (base != MAP_FAILED) ::munmap(base, length);
+        if (fd >= 0) ::close(fd);
+    }
+
+    mapped_file(const mapped_file &) = delete;
+    mapped_file &operator=(const mapped_file &) = delete;
+
+    const unsigned char *data() const {
+        return base == MAP_FAILED ? nullptr : static_cast<const unsigned char *>(base);
+    }
+    size_t size() const { return length; }
+};
+
+/**
+ * Checks the file size against the format and returns the number of values
+ * and the byte offset they start at
+ */
+template <typename T>
+std::pair<size_t, size_t> file_values(size_t fileSize, uint64_t prefix, file_format format,
+                                      const std::string &path) {
+    size_t header = format == file_format::length_prefixed ? sizeof(uint64_t) : 0;
+    if (fileSize < header) throw std::runtime_error("missing length prefix in " + path);
+    if ((fileSize - header) % sizeof(T) != 0) {
+        throw std::runtime_error("size of " + path + " is not a whole number of values");
+    }
+    size_t count = (fileSize - header) / sizeof(T);
+    if (format == file_format::length_prefixed && prefix != count) {
+        throw std::runtime_error("length prefix of " + path + " doesn't match its size");
+    }
+    return {count, header};
+}
+
+template <typename T>
+typename file_sum_traits<T>::acc reduce_window(const T *data, size_t n, reduce_policy policy) {
+    using traits = file_sum_traits<T>;
+    auto chunk = [data](size_t b, size_t e) { return traits::chunk(data + b, e - b); };
+    return reduce_chunks(n, typename traits::acc{}, chunk, traits::combine, policy);
+}
+
+template <typename T>
+typename file_sum_traits<T>::result sum_file_mapped(const std::string &path, file_format format,
+                                                    reduce_policy policy) {
+    using traits = file_sum_traits<T>;
+    mapped_file file(path);
+    uint64_t prefix = 0;
+    if (format == file_format::length_prefixed && file.size() >= sizeof(prefix)) {
+        std::memcpy(&prefix, file.data(), sizeof(prefix));
+    }
+    auto [count, header] = file_values<T>(file.size(), prefix, format, path);
+    // the mapping is page aligned and the header is 8 bytes, so every
+    // element type stays naturally aligned
+    const T *values = reinterpret_cast<const T *>(file.data() + header);
+    size_t window = file_window_bytes / sizeof(T);
+    size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+    auto page_range = [&](size_t first, size_t last, int advice) {
+        uintptr_t b = (uintptr_t)(values + first) & ~(uintptr_t)(page - 1);
+        uintptr_t e = (uintptr_t)(values + last);
+        if (e > b) ::madvise((void *)b, e - b, advice);
+    };
+
+    typename traits::acc total{};
+    for (size_t w = 0; w < count; w += window) {
+        size_t end = std::min(count, w + window);
+        page_range(end, std::min(count, end + window), MADV_WILLNEED);
+        total = traits::combine(total, reduce_window(values + w, end - w, policy));
+        // only whole pages before the next window may be dropped
+        uintptr_t done = (uintptr_t)(values + end) & ~(uintptr_t)(page - 1);
+        uintptr_t from = (uintptr_t)(values + w) & ~(uintptr_t)(page - 1);
+        if (done > from) ::madvise((void *)from, done - from, MADV_DONTNEED);
+    }
+    return traits::finish(total);
+}
+
+// fills buf with exactly bytes bytes from offset, retrying short reads
+inline void pread_fully(int fd, void *buf, size_t bytes, size_t offset, const std::string &path) {
+    auto *out = static_cast<unsigned char *>(buf);
+    while (bytes > 0) {
+        ssize_t got = ::pread(fd, out, bytes, (off_t)offset);
+        if (got < 0 && errno == EINTR) continue;
+        if (got < 0) throw file_error("cannot read", path);
+        if (got == 0) throw std::runtime_error("unexpected end of " + path);
+        out += got;
+        offset += (size_t)got;
+        bytes -= (size_t)got;
+    }
+}
+
+template <typename T>
+typename file_sum_traits<T>::result sum_file_streamed(const std::string &path,
+                                                      file_format format,
+                                                      reduce_policy policy) {
+    using traits = file_sum_traits<T>;
+    using acc = typename traits::acc;
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) throw file_error("cannot open", path);
+    struct closer {
+        int fd;
+        ~closer() { ::close(fd); }
+    } guard{fd};
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) throw file_error("cannot stat", path);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    uint64_t prefix = 0;
+    if (format == file_format::length_prefixed && (size_t)st.st_size >= sizeof(prefix)) {
+        pread_fully(fd, &prefix, sizeof(prefix), 0, path);
+    }
+    auto [count, header] = file_values<T>((size_t)st.st_size, prefix, format, path);
+
+    size_t window = file_window_bytes / sizeof(T);
+    std::vector<T> buffers[2];
+    buffers[0].resize(std::min(count, window));
+    buffers[1].resize(std::min(count, window));
+    auto read_window = [&](size_t w, std::vector<T> &buf) {
+        size_t n = std::min(count - w, window);
+        pread_fully(fd, buf.data(), n * sizeof(T), header + w * sizeof(T), path);
+        return n;
+    };
+
+    acc total{};
+    if (count == 0) return traits::finish(total);
+    size_t ready = read_window(0, buffers[0]);
+    int cur = 0;
+    for (size_t w = 0; w < count; w += window) {
+        const T *data = buffers[cur].data();
+        auto chunk = [data](size_t b, size_t e) { return traits::chunk(data + b, e - b); };
+        reduce_future<acc> pending =
+            reduce_chunks_async(ready, acc{}, chunk, traits::combine, policy);
+        // read the next window while the pool reduces this one
+        size_t next = 0;
+        try {
+            if (w + window < count) next = read_window(w + window, buffers[1 - cur]);
+        } catch (...) {
+            pending.wait();  // the pool still reads buffers[cur]
+            throw;
+        }
+        total = traits::combine(total, pending.get());
+        ready = next;
+        cur = 1 - cur;
+    }
+    return traits::finish(total);
+}
+
+/**
+ * Sums the T values in the file at path: int32 files sum to long long,
+ * int64 files to int128 and double files with Neumaier compensation.
+ * Throws std::runtime_error when the file can't be read or its size
+ * doesn't match the format
+ */
+template <typename T>
+typename file_sum_traits<T>::result sum_file(const std::string &path,
+                                             file_format format = file_format::raw,
+                                             file_access access = file_access::mmap,
+                                             reduce_policy policy = reduce_policy::auto_threads) {
+    policy.costScale *= file_sum_traits<T>::cost;
+    if (access == file_access::stream) return sum_file_streamed<T>(path, format, policy);
+    return sum_file_mapped<T>(path, format, policy);
+}
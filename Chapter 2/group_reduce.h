@@ -0,0 +1,279 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "aggregate.h"
+#include "reduce.h"
+#include "thread_pool.h"
+
+/**
+ * Parallel "sum per group" reductions on the sum_vector chunking. Every
+ * chunk aggregates its slice of (key, value) pairs into private tables, so
+ * threads never contend on shared counters, and the tables are merged at
+ * the end:
+ *   - keys spanning a small range go to dense per-chunk arrays indexed by
+ *     key, merged in parallel by splitting the key range across threads
+ *   - anything else goes to per-chunk open addressing hash tables, each
+ *     split by hash into one sub-table per merge thread, so the merge of
+ *     sub-table p across all chunks is independent of every other p
+ * Segments given as precomputed offsets need no tables at all
+ */
+template <typename K, typename A>
+struct group_sum {
+    K key;
+    A sum;
+    size_t count;
+};
+
+inline constexpr size_t dense_group_limit = (size_t)1 << 20;
+
+/**
+ * splitmix64's finalizer: every output bit depends on every key bit, so
+ * keys that differ only in their high bits (strided ids) still spread over
+ * the low probe bits
+ */
+inline uint64_t hash_key(uint64_t k) {
+    k += 0x9e3779b97f4a7c15ull;
+    k = (k ^ (k >> 30)) * 0xbf58476d1ce4e5b9ull;
+    k = (k ^ (k >> 27)) * 0x94d049bb133111ebull;
+    return k ^ (k >> 31);
+}
+
+/**
+ * Open addressing (linear probing) table from key to running sum and count
+ */
+template <typename K, typename A>
+class group_table {
+   private:
+    std::vector<K> keys;
+    std::vector<A> sums;
+    std::vector<size_t> counts;
+    std::vector<unsigned char> used;
+    size_t mask = 0;
+    size_t filled = 0;
+
+    void grow() {
+        group_table bigger(keys.size() * 2);
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (used[i]) bigger.add(keys[i], sums[i], counts[i]);
+        }
+        *this = std::move(bigger);
+    }
+
+   public:
+    explicit group_table(size_t capacity = 64) {
+        size_t cap = 16;
+        while (cap < capacity) cap *= 2;
+        keys.resize(cap);
+        sums.assign(cap, A());
+        counts.assign(cap, 0);
+        used.assign(cap, 0);
+        mask = cap - 1;
+    }
+
+    void add(K key, A value, size_t count = 1) {
+        if (2 * (filled + 1) > keys.size()) grow();
+        // the top bits pick the merge partition, so probe with the low ones
+        size_t i = hash_key((uint64_t)key) & mask;
+        while (used[i] && keys[i] != key) i = (i + 1) & mask;
+        if (!used[i]) {
+            used[i] = 1;
+            keys[i] = key;
+            filled++;
+        }
+        sums[i] += value;
+        counts[i] += count;
+    }
+
+    template <typename F>
+    void for_each(F &&fn) const {
+        for (size_t i = 0; i < keys.size(); i++) {
+            if (used[i]) fn(keys[i], sums[i], counts[i]);
+        }
+    }
+
+    size_t size() const { return filled; }
+};
+
+template <typename V>
+using group_acc_t = std::conditional_t<std::is_integral_v<V>, long long, double>;
+
+template <typename K, typename V>
+std::vector<group_sum<K, group_acc_t<V>>> group_sum_dense(const std::vector<K> &keys,
+                                                          const std::vector<V> &values,
+                                                          K lo, size_t range,
+                                                          reduce_policy policy) {
+    using A = group_acc_t<V>;
+    auto chunks = partition_range(keys.size(), policy.numThreads, policy.grain);
+    std::vector<std::vector<A>> sums(chunks.size());
+    std::vector<std::vector<size_t>> counts(chunks.size());
+    thread_pool &pool = default_pool();
+
+    pool.parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            std::vector<A> s(range, A());
+            std::vector<size_t> n(range, 0);
+            for (size_t i = chunks[c].first; i < chunks[c].second; i++) {
+                size_t slot = (size_t)(keys[i] - lo);
+                s[slot] += values[i];
+                n[slot]++;
+            }
+            sums[c] = std::move(s);
+            counts[c] = std::move(n);
+        },
+        policy.numThreads);
+
+    // every merge thread owns a slice of the key range across all chunks
+    auto slices = partition_range(range, (int)chunks.size());
+    std::vector<std::vector<group_sum<K, A>>> parts(slices.size());
+    pool.parallel_for(
+        slices.size(),
+        [&](size_t p) {
+            for (size_t slot = slices[p].first; slot < slices[p].second; slot++) {
+                A s = A();
+                size_t n = 0;
+                for (size_t c = 0; c < chunks.size(); c++) {
+                    s += sums[c][slot];
+                    n += counts[c][slot];
+                }
+                if (n) parts[p].push_back({(K)(lo + (K)slot), s, n});
+            }
+        },
+        policy.numThreads);
+
+    std::vector<group_sum<K, A>> out;
+    for (auto &p : parts) out.insert(out.end(), p.begin(), p.end());
+    return out;
+}
+
+template <typename K, typename V>
+std::vector<group_sum<K, group_acc_t<V>>> group_sum_hashed(const std::vector<K> &keys,
+                                                           const std::vector<V> &values,
+                                                           reduce_policy policy) {
+    using A = group_acc_t<V>;
+    auto chunks = partition_range(keys.size(), policy.numThreads, policy.grain);
+    size_t partitions = chunks.size();
+    // partition by the top hash bits, independent of the probe bits
+    auto partition_of = [partitions](K key) {
+        return (size_t)((hash_key((uint64_t)key) >> 32) * partitions >> 32);
+    };
+    std::vector<std::vector<group_table<K, A>>> tables(chunks.size());
+    thread_pool &pool = default_pool();
+
+    pool.parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            std::vector<group_table<K, A>> local(partitions);
+            for (size_t i = chunks[c].first; i < chunks[c].second; i++) {
+                local[partition_of(keys[i])].add(keys[i], values[i]);
+            }
+            tables[c] = std::move(local);
+        },
+        policy.numThreads);
+
+    std::vector<std::vector<group_sum<K, A>>> parts(partitions);
+    pool.parallel_for(
+        partitions,
+        [&](size_t p) {
+            size_t biggest = 0;
+            for (const auto &t : tables) biggest = std::max(biggest, t[p].size());
+            group_table<K, A> merged(2 * biggest);
+            for (const auto &t : tables) {
+                t[p].for_each([&](K k, A s, size_t n) { merged.add(k, s, n); });
+            }
+            parts[p].reserve(merged.size());
+            merged.for_each([&](K k, A s, size_t n) { parts[p].push_back({k, s, n}); });
+        },
+        policy.numThreads);
+
+    std::vector<group_sum<K, A>> out;
+    for (auto &p : parts) out.insert(out.end(), p.begin(), p.end());
+    return out;
+}
+
+/**
+ * Sums values[i] into the group keys[i] and counts the members of every
+ * group. Dense key ranges come back ordered by key, hashed ones in no
+ * particular order
+ */
+template <typename K, typename V>
+std::vector<group_sum<K, group_acc_t<V>>> group_sum_by_key(
+    const std::vector<K> &keys, const std::vector<V> &values,
+    reduce_policy policy = reduce_policy::auto_threads) {
+    static_assert(std::is_integral_v<K>, "group keys must be integers");
+    if (keys.size() != values.size()) throw std::invalid_argument("keys and values differ in size");
+    if (keys.empty()) return {};
+
+    // grouping does a table update per element, several times a plain add
+    policy.costScale *= 4;
+    policy = resolve_policy(keys.size(), policy);
+    aggregates<K> bounds = aggregate_vector(keys, agg_min | agg_max, policy);
+    // max - min, not the range itself, which wraps to 0 for 64 bit keys
+    // spanning every value
+    uint64_t span = (uint64_t)bounds.max - (uint64_t)bounds.min;
+    size_t chunks = partition_range(keys.size(), policy.numThreads, policy.grain).size();
+    // dense arrays pay off while all chunks' arrays cost no more than the input
+    if (span < dense_group_limit) {
+        size_t range = (size_t)span + 1;
+        if (range * chunks <= 2 * keys.size() + 4096) {
+            return group_sum_dense(keys, values, bounds.min, range, policy);
+        }
+    }
+    return group_sum_hashed(keys, values, policy);
+}
+
+/**
+ * Sums each segment [offsets[s], offsets[s + 1]) of values. Chunks split
+ * the values, not the segments, so one huge segment doesn't serialize the
+ * reduction: segments inside a chunk are written directly and only the two
+ * segments a chunk shares with its neighbours are patched up afterwards
+ */
+template <typename V>
+std::vector<group_acc_t<V>> segmented_sum(const std::vector<V> &values,
+                                          const std::vector<size_t> &offsets,
+                                          reduce_policy policy = reduce_policy::auto_threads) {
+    using A = group_acc_t<V>;
+    if (offsets.size() < 2) return {};
+    size_t segments = offsets.size() - 1;
+    if (offsets.back() > values.size()) throw std::invalid_argument("offsets past end of values");
+    std::vector<A> out(segments, A());
+
+    size_t begin = offsets.front(), n = offsets.back() - begin;
+    policy = resolve_policy(n, policy);
+    auto chunks = partition_range(n, policy.numThreads, policy.grain);
+    struct edge {
+        size_t segment;
+        A sum;
+    };
+    std::vector<std::vector<edge>> edges(chunks.size());
+
+    default_pool().parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            size_t b = begin + chunks[c].first, e = begin + chunks[c].second;
+            // last segment starting at or before b
+            size_t s = std::upper_bound(offsets.begin(), offsets.end(), b) - offsets.begin() - 1;
+            for (size_t i = b; i < e; s++) {
+                size_t segEnd = std::min(offsets[s + 1], e);
+                A sum = A();
+                for (; i < segEnd; i++) sum += values[i];
+                if (offsets[s] >= b && offsets[s + 1] <= e) {
+                    out[s] = sum;
+                } else {
+                    edges[c].push_back({s, sum});
+                }
+            }
+        },
+        policy.numThreads);
+
+    for (const auto &chunkEdges : edges) {
+        for (const edge &ed : chunkEdges) out[ed.segment] += ed.sum;
+    }
+    return out;
+}
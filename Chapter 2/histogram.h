@@ -0,0 +1,186 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "reduce.h"
+#include "simd_sum.h"
+#include "thread_pool.h"
+
+/**
+ * Parallel histograms on the sum_vector partitioning, in two modes:
+ *   - privatized: every chunk counts into its own bin array, each starting
+ *     on a cache line so no two threads ever write the same line, and the
+ *     arrays are summed with SIMD adds in parallel slices of the bin range
+ *   - atomic: one shared array of atomic bins, for bin counts so large that
+ *     a private copy per thread would cost more than the input itself
+ * The automatic mode privatizes while all private arrays together are no
+ * bigger than about twice the input, the same rule group_sum_by_key uses
+ * for its dense tables
+ */
+enum class histogram_mode { automatic, privatized, atomic };
+
+inline void add_counts_scalar(uint64_t *acc, const uint64_t *src, size_t n) {
+    for (size_t i = 0; i < n; i++) acc[i] += src[i];
+}
+
+#ifdef SIMD_SUM_X86
+SIMD_TARGET("avx2") inline void add_counts_avx2(uint64_t *acc, const uint64_t *src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(acc + i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(acc + i + 4));
+        a0 = _mm256_add_epi64(a0, _mm256_loadu_si256((const __m256i *)(src + i)));
+        a1 = _mm256_add_epi64(a1, _mm256_loadu_si256((const __m256i *)(src + i + 4)));
+        _mm256_storeu_si256((__m256i *)(acc + i), a0);
+        _mm256_storeu_si256((__m256i *)(acc + i + 4), a1);
+    }
+    add_counts_scalar(acc + i, src + i, n - i);
+}
+
+SIMD_TARGET("avx512f") inline void add_counts_avx512(uint64_t *acc, const uint64_t *src,
+                                                     size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i a0 = _mm512_add_epi64(_mm512_loadu_si512(acc + i), _mm512_loadu_si512(src + i));
+        __m512i a1 =
+            _mm512_add_epi64(_mm512_loadu_si512(acc + i + 8), _mm512_loadu_si512(src + i + 8));
+        _mm512_storeu_si512(acc + i, a0);
+        _mm512_storeu_si512(acc + i + 8, a1);
+    }
+    add_counts_scalar(acc + i, src + i, n - i);
+}
+#endif
+
+/**
+ * acc[i] += src[i] for i < n
+ */
+inline void add_counts(uint64_t *acc, const uint64_t *src, size_t n) {
+#ifdef SIMD_SUM_X86
+    switch (active_simd_level()) {
+        case simd_level::avx512:
+            return add_counts_avx512(acc, src, n);
+        case simd_level::avx2:
+            return add_counts_avx2(acc, src, n);
+        default:
+            break;
+    }
+#endif
+    add_counts_scalar(acc, src, n);
+}
+
+/**
+ * Adds p[b, e) to counts by bin, skipping values mapped to a bin >= bins:
+ * the private pass of the privatized histogram, which the radix sort also
+ * runs per chunk to count its digits
+ */
+template <typename T, typename BinFn>
+void count_bins(const T *p, size_t b, size_t e, size_t bins, const BinFn &bin_of,
+                uint64_t *counts) {
+    for (size_t i = b; i < e; i++) {
+        size_t k = bin_of(p[i]);
+        if (k < bins) counts[k]++;
+    }
+}
+
+template <typename T, typename BinFn>
+std::vector<uint64_t> histogram_privatized(const std::vector<T> &values, size_t bins,
+                                           const BinFn &bin_of, reduce_policy policy) {
+    auto chunks = partition_range(values.size(), policy.numThreads, policy.grain);
+    // one slab holds every chunk's bins, each array padded to whole lines
+    constexpr size_t perLine = cache_line_size / sizeof(uint64_t);
+    size_t stride = (bins + perLine - 1) / perLine * perLine;
+    std::vector<uint64_t> slab(chunks.size() * stride + perLine, 0);
+    uint64_t *base = slab.data();
+    while ((uintptr_t)base % cache_line_size != 0) base++;
+    thread_pool &pool = default_pool();
+
+    pool.parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            count_bins(values.data(), chunks[c].first, chunks[c].second, bins, bin_of,
+                       base + c * stride);
+        },
+        policy.numThreads);
+
+    // every merge thread owns whole lines of the bin range across all chunks
+    std::vector<uint64_t> out(bins, 0);
+    auto slices = partition_range(bins, (int)chunks.size(), perLine);
+    pool.parallel_for(
+        slices.size(),
+        [&](size_t s) {
+            size_t first = slices[s].first, len = slices[s].second - first;
+            for (size_t c = 0; c < chunks.size(); c++) {
+                add_counts(out.data() + first, base + c * stride + first, len);
+            }
+        },
+        policy.numThreads);
+    return out;
+}
+
+template <typename T, typename BinFn>
+std::vector<uint64_t> histogram_atomic(const std::vector<T> &values, size_t bins,
+                                       const BinFn &bin_of, reduce_policy policy) {
+    std::vector<std::atomic<uint64_t>> counts(bins);
+    for (auto &c : counts) c.store(0, std::memory_order_relaxed);
+    auto chunks = policy_chunks(values.size(), policy);
+    default_pool().parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            for (size_t i = chunks[c].first; i < chunks[c].second; i++) {
+                size_t b = bin_of(values[i]);
+                if (b < bins) counts[b].fetch_add(1, std::memory_order_relaxed);
+            }
+        },
+        policy.numThreads);
+    std::vector<uint64_t> out(bins);
+    for (size_t b = 0; b < bins; b++) out[b] = counts[b].load(std::memory_order_relaxed);
+    return out;
+}
+
+/**
+ * Counts values per bin, with bin_of(v) giving the bin of each value;
+ * values mapped to a bin >= bins are not counted
+ */
+template <typename T, typename BinFn>
+std::vector<uint64_t> histogram_by(const std::vector<T> &values, size_t bins, BinFn bin_of,
+                                   reduce_policy policy = reduce_policy::auto_threads,
+                                   histogram_mode mode = histogram_mode::automatic) {
+    if (bins == 0) return {};
+    if (values.empty()) return std::vector<uint64_t>(bins, 0);
+    // a bin update costs a few plain adds
+    policy.costScale *= 2;
+    policy = resolve_policy(values.size(), policy);
+    if (mode == histogram_mode::automatic) {
+        size_t chunks = partition_range(values.size(), policy.numThreads, policy.grain).size();
+        bool fits = bins * chunks <= 2 * values.size() + 4096;
+        mode = fits ? histogram_mode::privatized : histogram_mode::atomic;
+    }
+    if (mode == histogram_mode::atomic) return histogram_atomic(values, bins, bin_of, policy);
+    return histogram_privatized(values, bins, bin_of, policy);
+}
+
+/**
+ * Equal width histogram of [lo, hi) in the given number of bins; values
+ * outside the range (and NaN) are not counted
+ */
+template <typename T>
+std::vector<uint64_t> histogram(const std::vector<T> &values, double lo, double hi, size_t bins,
+                                reduce_policy policy = reduce_policy::auto_threads,
+                                histogram_mode mode = histogram_mode::automatic) {
+    static_assert(std::is_arithmetic_v<T>, "histogram needs numeric values");
+    if (!(hi > lo)) throw std::invalid_argument("histogram range is empty");
+    double scale = (double)bins / (hi - lo);
+    auto bin_of = [lo, hi, scale, bins](T v) {
+        double x = (double)v;
+        if (!(x >= lo && x < hi)) return bins;
+        // rounding can push values just below hi into bin `bins`
+        return std::min((size_t)((x - lo) * scale), bins - 1);
+    };
+    return histogram_by(values, bins, bin_of, policy, mode);
+}
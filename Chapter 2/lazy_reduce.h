@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "accurate_sum.h"
+#include "reduce.h"
+
+/**
+ * Lazy inputs for the parallel reduction. A view describes values by index
+ * (a generator, or an existing array) plus a chain of map and filter
+ * stages; nothing is materialized. Reducing a view splits its index space
+ * into the usual chunks and every chunk runs generator, stages and
+ * accumulation as one fused loop, so transformed values go straight from
+ * registers into the accumulator:
+ *
+ *   lazy_iota(1, 1001).map([](int x) { return x * x; })
+ *                     .filter([](int x) { return x % 2; }).sum();
+ */
+template <typename Base, typename F>
+class map_view;
+
+template <typename Base, typename P>
+class filter_view;
+
+template <typename Derived>
+class lazy_view {
+   private:
+    const Derived &self() const { return static_cast<const Derived &>(*this); }
+
+   public:
+    template <typename F>
+    map_view<Derived, F> map(F fn) const {
+        return map_view<Derived, F>(self(), std::move(fn));
+    }
+
+    template <typename P>
+    filter_view<Derived, P> filter(P pred) const {
+        return filter_view<Derived, P>(self(), std::move(pred));
+    }
+
+    /**
+     * Folds the values with an associative op, chunks combined in order
+     * like parallel_reduce
+     */
+    template <typename T, typename BinaryOp>
+    T reduce(T identity, BinaryOp op, reduce_policy policy = reduce_policy::auto_threads) const {
+        const Derived &view = self();
+        auto chunk = [&view, &op, &identity](size_t b, size_t e) {
+            T acc = identity;
+            view.for_each(b, e, [&](auto &&v) { acc = op(acc, std::forward<decltype(v)>(v)); });
+            return acc;
+        };
+        return reduce_chunks(view.size(), identity, chunk, op, policy);
+    }
+
+    /**
+     * Sums like sum_vector: integers wrap in the value type, floating point
+     * is Neumaier compensated
+     */
+    auto sum(reduce_policy policy = reduce_policy::auto_threads) const {
+        using V = typename Derived::value_type;
+        const Derived &view = self();
+        if constexpr (std::is_floating_point_v<V>) {
+            auto chunk = [&view](size_t b, size_t e) {
+                compensated acc;
+                view.for_each(b, e, [&](double v) { neumaier_add(acc, v); });
+                return acc;
+            };
+            return reduce_chunks(view.size(), compensated{}, chunk, merge_compensated, policy)
+                .value();
+        } else {
+            return reduce(V(), wrapping_plus(), policy);
+        }
+    }
+};
+
+/**
+ * Value i is fn(i) for i in [0, n)
+ */
+template <typename F>
+class generate_view : public lazy_view<generate_view<F>> {
+   private:
+    size_t n;
+    F fn;
+
+   public:
+    using value_type = std::decay_t<std::invoke_result_t<const F &, size_t>>;
+
+    generate_view(size_t count, F f) : n(count), fn(std::move(f)) {}
+
+    size_t size() const { return n; }
+
+    template <typename Sink>
+    void for_each(size_t b, size_t e, Sink &&sink) const {
+        for (size_t i = b; i < e; i++) sink(fn(i));
+    }
+};
+
+/**
+ * The values of an existing array, so map and filter stages can be fused
+ * over real data too. The array must outlive the view
+ */
+template <typename T>
+class array_lazy_view : public lazy_view<array_lazy_view<T>> {
+   private:
+    const T *data;
+    size_t n;
+
+   public:
+    using value_type = T;
+
+    array_lazy_view(const T *p, size_t count) : data(p), n(count) {}
+
+    size_t size() const { return n; }
+
+    template <typename Sink>
+    void for_each(size_t b, size_t e, Sink &&sink) const {
+        for (size_t i = b; i < e; i++) sink(data[i]);
+    }
+};
+
+template <typename Base, typename F>
+class map_view : public lazy_view<map_view<Base, F>> {
+   private:
+    Base base;
+    F fn;
+
+   public:
+    using value_type =
+        std::decay_t<std::invoke_result_t<const F &, const typename Base::value_type &>>;
+
+    map_view(Base b, F f) : base(std::move(b)), fn(std::move(f)) {}
+
+    size_t size() const { return base.size(); }
+
+    template <typename Sink>
+    void for_each(size_t b, size_t e, Sink &&sink) const {
+        base.for_each(b, e, [&](auto &&v) { sink(fn(std::forward<decltype(v)>(v))); });
+    }
+};
+
+/**
+ * Keeps the values pred accepts. size() is still the index space of the
+ * underlying view, which is what gets chunked
+ */
+template <typename Base, typename P>
+class filter_view : public lazy_view<filter_view<Base, P>> {
+   private:
+    Base base;
+    P pred;
+
+   public:
+    using value_type = typename Base::value_type;
+
+    filter_view(Base b, P p) : base(std::move(b)), pred(std::move(p)) {}
+
+    size_t size() const { return base.size(); }
+
+    template <typename Sink>
+    void for_each(size_t b, size_t e, Sink &&sink) const {
+        base.for_each(b, e, [&](auto &&v) {
+            if (pred(v)) sink(std::forward<decltype(v)>(v));
+        });
+    }
+};
+
+template <typename F>
+generate_view<F> lazy_generate(size_t n, F fn) {
+    return generate_view<F>(n, std::move(fn));
+}
+
+/**
+ * first, first + 1, ..., last - 1
+ */
+template <typename T>
+auto lazy_iota(T first, T last) {
+    static_assert(std::is_integral_v<T>, "lazy_iota needs an integer type");
+    size_t n = last > first ? (size_t)(last - first) : 0;
+    return lazy_generate(n, [first](size_t i) { return (T)(first + (T)i); });
+}
+
+template <typename T>
+array_lazy_view<T> lazy_over(const std::vector<T> &values) {
+    return array_lazy_view<T>(values.data(), values.size());
+}
@@ -0,0 +1,54 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "matrix_reduce.h"
+#include "reduce.h"
+#include "timing.h"
+
+/**
+ * Row and column sums of a row-major matrix: a sum_vector call per row (on
+ * the matrix stored as one vector per row) and a column by column strided
+ * loop, against the tiled row_sums and column_sums.
+ *
+ * usage: matrix_bench [rows] [cols] [threads]
+ */
+int main(int argc, char **argv) {
+    size_t rows = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000;
+    size_t cols = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 10000;
+    reduce_policy policy = argc > 3 ? reduce_policy(std::atoi(argv[3]))
+                                    : reduce_policy(reduce_policy::auto_threads);
+
+    std::vector<int> m(rows * cols);
+    for (size_t i = 0; i < m.size(); i++) m[i] = (int)(i % 1001) - 500;
+    std::vector<std::vector<int>> perRow(rows);
+    for (size_t r = 0; r < rows; r++) {
+        perRow[r].assign(m.begin() + r * cols, m.begin() + (r + 1) * cols);
+    }
+
+    std::vector<int> rowRef(rows), colRef(cols), rowOut, colOut;
+    double rowLoop = 1e3 * best_seconds(3, [&] {
+        for (size_t r = 0; r < rows; r++) rowRef[r] = sum_vector(perRow[r], policy);
+    });
+    double rowTiled = 1e3 * best_seconds(3, [&] { rowOut = row_sums(m, rows, cols, policy); });
+    // strided walks are slow enough that one run is plenty
+    double colLoop = 1e3 * time_seconds([&] {
+        for (size_t c = 0; c < cols; c++) {
+            unsigned acc = 0;
+            for (size_t r = 0; r < rows; r++) acc += (unsigned)m[r * cols + c];
+            colRef[c] = (int)acc;
+        }
+    });
+    double colTiled = 1e3 * best_seconds(3, [&] { colOut = column_sums(m, rows, cols, policy); });
+
+    std::cout << rows << " x " << cols << std::endl;
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "row sums, sum_vector per row: " << rowLoop << " ms" << std::endl;
+    std::cout << "row sums, tiled:              " << rowTiled << " ms" << std::endl;
+    std::cout << "column sums, strided loop:    " << colLoop << " ms" << std::endl;
+    std::cout << "column sums, tiled:           " << colTiled << " ms" << std::endl;
+    bool ok = rowOut == rowRef && colOut == colRef;
+    std::cout << "Correct: " << (ok ? "Yes" : "No") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "reduce.h"
+#include "simd_sum.h"
+#include "thread_pool.h"
+
+/**
+ * Row and column sums of row-major int matrices in one parallel pass each,
+ * instead of a sum_vector dispatch per row. Rows are split into one band
+ * per thread; row sums run sum_int over the rows of a band (and with
+ * fewer rows than threads also split every row into column segments, so
+ * short, wide matrices still keep every thread busy), column sums
+ * split each band further into strips of matrix_col_tile columns, so the
+ * tile's accumulators stay in L1 while its row segments stream past and
+ * are added in with whole SIMD registers across the columns. The bands'
+ * column partials are merged in parallel by strip. Sums wrap on overflow
+ * like sum_vector
+ */
+inline constexpr size_t matrix_col_tile = 4096;
+
+inline void add_row_scalar(unsigned *acc, const int *row, size_t w) {
+    for (size_t j = 0; j < w; j++) acc[j] += (unsigned)row[j];
+}
+
+#ifdef SIMD_SUM_X86
+SIMD_TARGET("avx2") inline void add_row_avx2(unsigned *acc, const int *row, size_t w) {
+    size_t j = 0;
+    for (; j + 16 <= w; j += 16) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(acc + j));
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(acc + j + 8));
+        a0 = _mm256_add_epi32(a0, _mm256_loadu_si256((const __m256i *)(row + j)));
+        a1 = _mm256_add_epi32(a1, _mm256_loadu_si256((const __m256i *)(row + j + 8)));
+        _mm256_storeu_si256((__m256i *)(acc + j), a0);
+        _mm256_storeu_si256((__m256i *)(acc + j + 8), a1);
+    }
+    add_row_scalar(acc + j, row + j, w - j);
+}
+
+SIMD_TARGET("avx512f") inline void add_row_avx512(unsigned *acc, const int *row, size_t w) {
+    size_t j = 0;
+    for (; j + 32 <= w; j += 32) {
+        __m512i a0 = _mm512_add_epi32(_mm512_loadu_si512(acc + j), _mm512_loadu_si512(row + j));
+        __m512i a1 =
+            _mm512_add_epi32(_mm512_loadu_si512(acc + j + 16), _mm512_loadu_si512(row + j + 16));
+        _mm512_storeu_si512(acc + j, a0);
+        _mm512_storeu_si512(acc + j + 16, a1);
+    }
+    add_row_scalar(acc + j, row + j, w - j);
+}
+#endif
+
+/**
+ * acc[j] += row[j] for j < w, wrapping
+ */
+inline void add_row(unsigned *acc, const int *row, size_t w) {
+#ifdef SIMD_SUM_X86
+    switch (active_simd_level()) {
+        case simd_level::avx512:
+            return add_row_avx512(acc, row, w);
+        case simd_level::avx2:
+            return add_row_avx2(acc, row, w);
+        default:
+            break;
+    }
+#endif
+    add_row_scalar(acc, row, w);
+}
+
+inline void check_matrix(size_t size, size_t rows, size_t cols) {
+    if (rows * cols != size) throw std::invalid_argument("matrix shape doesn't match its size");
+}
+
+/**
+ * Sum of every row of the rows x cols matrix m
+ */
+inline std::vector<int> row_sums(const int *m, size_t rows, size_t cols,
+                                 reduce_policy policy = reduce_policy::auto_threads) {
+    std::vector<int> out(rows, 0);
+    if (rows == 0 || cols == 0) return out;
+    policy = resolve_policy(rows * cols, policy);
+    if (rows >= (size_t)policy.numThreads) {
+        auto bands = partition_range(rows, policy.numThreads);
+        default_pool().parallel_for(
+            bands.size(),
+            [&](size_t b) {
+                for (size_t r = bands[b].first; r < bands[b].second; r++) {
+                    out[r] = sum_int(m + r * cols, cols);
+                }
+            },
+            policy.numThreads);
+        return out;
+    }
+
+    // fewer rows than threads: split every row into column segments too
+    size_t perRow = ((size_t)policy.numThreads + rows - 1) / rows;
+    auto segments = partition_range(cols, (int)perRow, matrix_col_tile);
+    size_t count = segments.size();
+    std::vector<padded<unsigned>> partials(rows * count);
+    default_pool().parallel_for(
+        rows * count,
+        [&](size_t t) {
+            const auto &seg = segments[t % count];
+            const int *row = m + (t / count) * cols;
+            partials[t].value = (unsigned)sum_int(row + seg.first, seg.second - seg.first);
+        },
+        policy.numThreads);
+    for (size_t r = 0; r < rows; r++) {
+        unsigned acc = 0;
+        for (size_t s = 0; s < count; s++) acc += partials[r * count + s].value;
+        out[r] = (int)acc;
+    }
+    return out;
+}
+
+/**
+ * Sum of every column of the rows x cols matrix m
+ */
+inline std::vector<int> column_sums(const int *m, size_t rows, size_t cols,
+                                    reduce_policy policy = reduce_policy::auto_threads) {
+    std::vector<int> out(cols, 0);
+    if (rows == 0 || cols == 0) return out;
+    policy = resolve_policy(rows * cols, policy);
+    auto bands = partition_range(rows, policy.numThreads);
+    auto strips = partition_range(cols, (int)((cols + matrix_col_tile - 1) / matrix_col_tile));
+    // partials[band * cols + j]: band's sum of column j
+    std::vector<unsigned> partials(bands.size() * cols, 0);
+    thread_pool &pool = default_pool();
+
+    pool.parallel_for(
+        bands.size() * strips.size(),
+        [&](size_t t) {
+            const auto &band = bands[t / strips.size()];
+            const auto &strip = strips[t % strips.size()];
+            unsigned *acc = partials.data() + (t / strips.size()) * cols + strip.first;
+            size_t w = strip.second - strip.first;
+            for (size_t r = band.first; r < band.second; r++) {
+                add_row(acc, m + r * cols + strip.first, w);
+            }
+        },
+        policy.numThreads);
+
+    pool.parallel_for(
+        strips.size(),
+        [&](size_t s) {
+            const auto &strip = strips[s];
+            size_t w = strip.second - strip.first;
+            unsigned *acc = reinterpret_cast<unsigned *>(out.data()) + strip.first;
+            const int *bandSums = reinterpret_cast<const int *>(partials.data()) + strip.first;
+            for (size_t b = 0; b < bands.size(); b++) add_row(acc, bandSums + b * cols, w);
+        },
+        policy.numThreads);
+    return out;
+}
+
+inline std::vector<int> row_sums(const std::vector<int> &m, size_t rows, size_t cols,
+                                 reduce_policy policy = reduce_policy::auto_threads) {
+    check_matrix(m.size(), rows, cols);
+    return row_sums(m.data(), rows, cols, policy);
+}
+
+inline std::vector<int> column_sums(const std::vector<int> &m, size_t rows, size_t cols,
+                                    reduce_policy policy = reduce_policy::auto_threads) {
+    check_matrix(m.size(), rows, cols);
+    return column_sums(m.data(), rows, cols, policy);
+}
@@ -1,68 +1,21 @@
 #include <algorithm>
-#include <cmath>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <numeric>
-#include <thread>
-#include <utility>
+#include <string>
 #include <vector>
 
-/**
- * naive implementation of a sum reduction in which
- * threads independently sum assigned chunks of a vector
- * and the main thread sums the chunks to get the final result
- */
-struct Work {
-    std::vector<int> &arr;
-    std::pair<int, int> bounds;
-    int sum;
-
-    Work(std::vector<int> &arr_, int s, int e) : arr(arr_), bounds({s, e}), sum(0) {}
-
-    void operator()() {
-        for (int i = bounds.first; i < bounds.second; i++) {
-            sum += arr[i];
-        }
-    }
-};
-
-int sum_vector(std::vector<int> &arr, int numThreads) {
-    if (arr.empty()) return 0;
-    if (numThreads <= 0) numThreads = 1;
-
-    // Create worker objects first and keep them alive
-    std::vector<Work> workers;
-    workers.reserve(numThreads);
-
-    int chunkSize = (int)std::ceil(arr.size() / static_cast<double>(numThreads));
-
-    for (size_t i = 0; i < arr.size(); i += chunkSize) {
-        size_t end = std::min(i + chunkSize, arr.size());
-        workers.emplace_back(arr, i, end);
-    }
-
-    // Now create threads, using references to our worker objects
-    std::vector<std::thread> threads;
-    threads.reserve(workers.size());
-
-    for (auto &worker : workers) {
-        threads.emplace_back(std::ref(worker));
-    }
-
-    // Join all threads
-    for (auto &t : threads) {
-        if (t.joinable()) {
-            t.join();
-        }
-    }
-
-    // Sum up results
-    int total = 0;
-    for (const auto &w : workers) {
-        total += w.sum;
-    }
-
-    return total;
-}
+#include "aggregate.h"
+#include "async_reduce.h"
+#include "fenwick.h"
+#include "group_reduce.h"
+#include "histogram.h"
+#include "lazy_reduce.h"
+#include "reduce.h"
+#include "search.h"
+#include "select.h"
+#include "static_reduce.h"
 
 int main() {
     // Create test vector with known sum
@@ -79,5 +32,166 @@ int main() {
     std::cout << "Expected sum: " << expected_sum << std::endl;
     std::cout << "Correct: " << (threaded_sum == expected_sum ? "Yes" : "No") << std::endl;
 
+    // Auto mode runs inputs this small inline rather than waking the pool
+    reduce_policy chosen = resolve_policy(test_vector.size(), reduce_policy::auto_threads);
+    std::cout << "Auto sum: " << sum_vector(test_vector) << " using " << chosen.numThreads
+              << " thread(s); 10M elements would use "
+              << resolve_policy(10000000, reduce_policy::auto_threads).numThreads << std::endl;
+
+    // The same sums over generated values, without filling a vector first
+    std::cout << "Lazy sum: " << lazy_iota(1, 1001).sum(thread_count) << ", sum of odd squares: "
+              << lazy_iota(1, 1001)
+                     .map([](int x) { return x * x; })
+                     .filter([](int x) { return x % 2 != 0; })
+                     .sum(thread_count)
+              << std::endl;
+
+    // Sum, min, max and xor through the compile-time specialized kernels
+    bool staticOk = static_reduce_vector<min_op>(test_vector, 4) == 1 &&
+                    static_reduce_vector<max_op>(test_vector, 4) == 1000 &&
+                    static_reduce_vector<xor_op>(test_vector, 4) == 0x3e8 &&
+                    static_reduce_vector<plus_op, long long>(test_vector, 4) == expected_sum;
+    std::cout << "Specialized kernels correct: " << (staticOk ? "Yes" : "No") << std::endl;
+
+    // The same engine works for any associative op with an identity element
+    auto min_fn = [](int a, int b) { return std::min(a, b); };
+    auto max_fn = [](int a, int b) { return std::max(a, b); };
+    auto xor_fn = [](int a, int b) { return a ^ b; };
+    int lowest = std::numeric_limits<int>::min(), highest = std::numeric_limits<int>::max();
+    std::cout << "\nMin: " << parallel_reduce(test_vector, highest, min_fn, 4) << std::endl;
+    std::cout << "Max: " << parallel_reduce(test_vector, lowest, max_fn, 4) << std::endl;
+    std::cout << "Xor: " << parallel_reduce(test_vector, 0, xor_fn, 4) << std::endl;
+
+    // Custom monoid: concatenation is associative but not commutative,
+    // so this also checks that chunks are combined in order
+    std::vector<std::string> words;
+    for (int i = 0; i < 10; i++) words.push_back(std::to_string(i));
+    std::cout << "Concat: " << parallel_reduce(words, std::string(), std::plus<std::string>(), 4)
+              << std::endl;
+
+    // Searches stop every worker as soon as the first match is known
+    std::cout << "First element > 990 at index "
+              << parallel_find(test_vector, compare::gt, 990, thread_count)
+              << ", all positive: "
+              << parallel_all_of(test_vector, [](int x) { return x > 0; }, thread_count)
+              << std::endl;
+
+    // Several statistics from a single pass over the data
+    aggregates<int> stats = aggregate_vector(test_vector, agg_all, thread_count);
+    std::cout << "\nCount: " << stats.count << ", sum: " << stats.sum << ", min: " << stats.min
+              << ", max: " << stats.max << ", mean: " << stats.mean
+              << ", variance: " << stats.variance() << std::endl;
+
+    // Order statistics without sorting
+    std::cout << "Top 3:";
+    for (int v : parallel_top_k(test_vector, 3, std::greater<int>(), thread_count)) {
+        std::cout << " " << v;
+    }
+    std::cout << ", median: " << parallel_quantile(test_vector, 0.5, thread_count)
+              << ", 90th percentile: " << parallel_quantile(test_vector, 0.9, thread_count)
+              << std::endl;
+
+    // Bucket counts: four equal bins over [1, 1001)
+    std::cout << "Histogram:";
+    for (uint64_t c : histogram(test_vector, 1, 1001, 4, thread_count)) std::cout << " " << c;
+    std::cout << std::endl;
+
+    // Both bin layouts, forced, agree with a sequential count by last digit
+    auto digit = [](int v) { return (size_t)(v % 10); };
+    std::vector<uint64_t> digits(10, 0);
+    for (int v : test_vector) digits[digit(v)]++;
+    bool modesOk = true;
+    for (histogram_mode m : {histogram_mode::privatized, histogram_mode::atomic}) {
+        modesOk = modesOk && histogram_by(test_vector, 10, digit, thread_count, m) == digits;
+    }
+    std::cout << "Privatized and atomic bins correct: " << (modesOk ? "Yes" : "No") << std::endl;
+
+    // Per-group sums, e.g. amounts per account id
+    std::vector<int> account(test_vector.size());
+    for (size_t i = 0; i < account.size(); i++) account[i] = (int)(i % 3);
+    for (const auto &g : group_sum_by_key(account, test_vector, thread_count)) {
+        std::cout << "Account " << g.key << ": " << g.count << " entries, total " << g.sum
+                  << std::endl;
+    }
+
+    // Many groups with ids far apart take the hashed path; check it against
+    // a sequential count, with keys spanning the whole 64 bit range too
+    std::vector<long long> ids(200000);
+    std::vector<int> amounts(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        ids[i] = (long long)(i % 20000) * 65536;
+        amounts[i] = (int)(i % 7);
+    }
+    ids[0] = std::numeric_limits<long long>::min();
+    ids[1] = std::numeric_limits<long long>::max();
+    std::map<long long, std::pair<long long, size_t>> reference;
+    for (size_t i = 0; i < ids.size(); i++) {
+        reference[ids[i]].first += amounts[i];
+        reference[ids[i]].second++;
+    }
+    auto groups = group_sum_by_key(ids, amounts, thread_count);
+    bool groupsOk = groups.size() == reference.size();
+    for (const auto &g : groups) {
+        auto it = reference.find(g.key);
+        groupsOk = groupsOk && it != reference.end() && it->second.first == g.sum &&
+                   it->second.second == g.count;
+    }
+    std::cout << "Hashed groups: " << groups.size() << ", correct: " << (groupsOk ? "Yes" : "No")
+              << std::endl;
+
+    // Segment sums, with empty segments and segments straddling chunks
+    std::vector<size_t> offsets = {0, 0, 3, 3, 500, 501, 999, 1000, 1000};
+    std::vector<long long> segments = segmented_sum(test_vector, offsets, thread_count);
+    bool segmentsOk = segments.size() == offsets.size() - 1;
+    for (size_t s = 0; segmentsOk && s + 1 < offsets.size(); s++) {
+        long long expected = std::accumulate(test_vector.begin() + offsets[s],
+                                             test_vector.begin() + offsets[s + 1], 0LL);
+        segmentsOk = segments[s] == expected;
+    }
+    std::cout << "Segment sums:";
+    for (long long s : segments) std::cout << " " << s;
+    std::cout << ", correct: " << (segmentsOk ? "Yes" : "No") << std::endl;
+
+    // Incremental sums: a few point updates, then O(log n) queries that
+    // match a full recompute
+    concurrent_fenwick tree(test_vector, thread_count);
+    tree.set(0, 1000);
+    tree.add(999, -500);
+    std::vector<int> updated = test_vector;
+    updated[0] = 1000;
+    updated[999] -= 500;
+    std::cout << "Tree total after updates: " << tree.total()
+              << ", recomputed: " << sum_vector(updated, thread_count)
+              << ", sum of [10, 20): " << tree.range_sum(10, 20) << std::endl;
+
+    // Asynchronous sums: start several reductions, keep working, then
+    // collect all of them at once
+    std::vector<std::vector<int>> batches;
+    for (int b = 1; b <= 3; b++) batches.emplace_back(1000 * b, b);
+    std::vector<reduce_future<int>> pending;
+    for (const auto &batch : batches) pending.push_back(sum_vector_async(batch, thread_count));
+    std::cout << "Batch sums:";
+    for (int total : when_all(pending).get()) std::cout << " " << total;
+    std::cout << std::endl;
+
+    // Large inputs overflow the int accumulator; the wide sum does not
+    std::vector<int> big(100000, 50000);
+    std::cout << "\nInt sum of 100000 x 50000: " << sum_vector(big, thread_count) << std::endl;
+    std::cout << "Wide sum of 100000 x 50000: " << sum_vector_wide(big, thread_count)
+              << std::endl;
+
+    // Floating point modes on a sum that loses small terms next to large ones
+    std::vector<double> mixed;
+    for (int i = 0; i < 1000; i++) {
+        mixed.push_back(1e16);
+        mixed.push_back(1.0);
+        mixed.push_back(-1e16);
+    }
+    std::cout << "Expected floating point sum: 1000" << std::endl;
+    for (sum_mode m : {sum_mode::fast, sum_mode::kahan, sum_mode::neumaier, sum_mode::pairwise}) {
+        std::cout << "  " << sum_mode_name(m) << ": " << sum_vector(mixed, thread_count, m)
+                  << std::endl;
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "reduce.h"
+#include "thread_pool.h"
+
+/**
+ * NUMA-aware reductions for multi-socket Linux machines, using only the
+ * /sys topology and raw sched_setaffinity/mbind (no libnuma). A
+ * numa_array splits its storage into one partition per node, binds each
+ * partition's pages to its node and first-touches them from that node's
+ * threads. Reductions run each partition on a pool pinned to the owning
+ * node and combine the partials per node before combining the nodes
+ */
+struct numa_node {
+    int id;
+    std::vector<int> cpus;
+};
+
+// parses the kernel's list format, e.g. "0-3,8,10-11"
+inline std::vector<int> parse_cpu_list(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream ss(list);
+    std::string range;
+    while (std::getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") continue;
+        size_t dash = range.find('-');
+        int lo = std::stoi(range.substr(0, dash));
+        int hi = dash == std::string::npos ? lo : std::stoi(range.substr(dash + 1));
+        for (int c = lo; c <= hi; c++) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+inline std::string read_sys_file(const std::string &path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+/**
+ * Nodes with CPUs this process may run on. Memory-only nodes are left out
+ * since nothing can reduce there; without /sys node information the whole
+ * machine is one node
+ */
+inline const std::vector<numa_node> &numa_topology() {
+    static std::vector<numa_node> nodes = [] {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool haveMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+        auto usable = [&](int cpu) {
+            return !haveMask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed));
+        };
+
+        std::vector<numa_node> found;
+        std::string online = read_sys_file("/sys/devices/system/node/online");
+        for (int id : parse_cpu_list(online)) {
+            std::string path = "/sys/devices/system/node/node" + std::to_string(id) + "/cpulist";
+            numa_node node{id, {}};
+            for (int cpu : parse_cpu_list(read_sys_file(path))) {
+                if (usable(cpu)) node.cpus.push_back(cpu);
+            }
+            if (!node.cpus.empty()) found.push_back(std::move(node));
+        }
+        if (found.empty()) {
+            numa_node all{0, {}};
+            int hw = (int)std::max(1u, std::thread::hardware_concurrency());
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                if (haveMask ? CPU_ISSET(cpu, &allowed) : cpu < hw) all.cpus.push_back(cpu);
+            }
+            found.push_back(std::move(all));
+        }
+        return found;
+    }();
+    return nodes;
+}
+
+inline bool pin_thread_to_cpu(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+/**
+ * Binds the pages of [addr, addr + len) to a node, moving any that were
+ * already touched. addr must be page aligned
+ */
+inline bool bind_to_node(void *addr, size_t len, int node) {
+    const size_t bitsPerWord = 8 * sizeof(unsigned long);
+    std::vector<unsigned long> mask(node / bitsPerWord + 1, 0);
+    mask[node / bitsPerWord] |= 1ul << (node % bitsPerWord);
+    long rc = syscall(SYS_mbind, addr, len, MPOL_BIND, mask.data(),
+                      mask.size() * bitsPerWord + 1, MPOL_MF_MOVE);
+    return rc == 0;
+}
+
+/**
+ * One pool per node whose workers are each pinned to a core of that node
+ */
+inline std::vector<std::unique_ptr<thread_pool>> &numa_pools() {
+    static std::vector<std::unique_ptr<thread_pool>> pools = [] {
+        std::vector<std::unique_ptr<thread_pool>> p;
+        for (const numa_node &node : numa_topology()) {
+            std::vector<int> cpus = node.cpus;
+            p.push_back(std::make_unique<thread_pool>(
+                (unsigned)cpus.size(), [cpus](unsigned i) { pin_thread_to_cpu(cpus[i]); }));
+        }
+        return p;
+    }();
+    return pools;
+}
+
+/**
+ * Runs fn(node index) on a worker of every node's pool at once and waits
+ * for all of them
+ */
+template <typename F>
+void for_each_numa_node(F &&fn) {
+    auto &pools = numa_pools();
+    std::mutex m;
+    std::condition_variable cv;
+    size_t remaining = pools.size();
+    std::exception_ptr error;
+    for (size_t k = 0; k < pools.size(); k++) {
+        pools[k]->submit([&, k] {
+            try {
+                fn(k);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(m);
+                if (!error) error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(m);
+            if (--remaining == 0) cv.notify_all();
+        });
+    }
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait(lock, [&] { return remaining == 0; });
+    if (error) std::rethrow_exception(error);
+}
+
+/**
+ * Fixed-size array of trivially copyable values whose storage is split into
+ * page aligned partitions, one per NUMA node, each allocated and
+ * first-touched on the node that will reduce it
+ */
+template <typename T>
+class numa_array {
+    static_assert(std::is_trivially_copyable_v<T>, "numa_array needs trivially copyable values");
+
+   private:
+    T *ptr = nullptr;
+    size_t n = 0;
+    size_t bytes = 0;
+    std::vector<std::pair<size_t, size_t>> parts;  // element range per node
+    bool bound = true;  // false when any mbind failed, leaving first touch only
+
+   public:
+    /**
+     * Initializes element i to init(i), writing each partition from its
+     * own node's threads so its pages are first touched there
+     */
+    template <typename Init>
+    numa_array(size_t count, Init init) : n(count) {
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        bytes = std::max(page, (n * sizeof(T) + page - 1) / page * page);
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+        void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (mem == MAP_FAILED) throw std::bad_alloc();
+        ptr = static_cast<T *>(mem);
+
+        const auto &nodes = numa_topology();
+        size_t perPage = std::max<size_t>(1, page / sizeof(T));
+        size_t perNode = (n + nodes.size() - 1) / nodes.size();
+        perNode = (perNode + perPage - 1) / perPage * perPage;
+        for (size_t k = 0; k < nodes.size(); k++) {
+            size_t b = std::min(n, k * perNode), e = std::min(n, b + perNode);
+            parts.emplace_back(b, e);
+            if (e > b) {
+                size_t len = (e - b) * sizeof(T);
+                bound &= bind_to_node(ptr + b, (len + page - 1) / page * page, nodes[k].id);
+            }
+        }
+
+        try {
+            for_each_numa_node([&](size_t k) {
+                thread_pool &pool = *numa_pools()[k];
+                auto chunks = partition_range(parts[k].second - parts[k].first, (int)pool.size());
+                pool.parallel_for(chunks.size(), [&](size_t c) {
+                    for (size_t i = chunks[c].first; i < chunks[c].second; i++) {
+                        size_t idx = parts[k].first + i;
+                        new (ptr + idx) T(init(idx));
+                    }
+                });
+            });
+        } catch (...) {
+            munmap(ptr, bytes);
+            throw;
+        }
+    }
+
+    explicit numa_array(const std::vector<T> &src)
+        : numa_array(src.size(), [&src](size_t i) { return src[i]; }) {}
+
+    ~numa_array() {
+        if (ptr) munmap(ptr, bytes);
+    }
+
+    numa_array(const numa_array &) = delete;
+    numa_array &operator=(const numa_array &) = delete;
+
+    numa_array(numa_array &&other) noexcept
+        : ptr(other.ptr),
+          n(other.n),
+          bytes(other.bytes),
+          parts(std::move(other.parts)),
+          bound(other.bound) {
+        other.ptr = nullptr;
+        other.n = 0;
+    }
+
+    T *data() { return ptr; }
+    const T *data() const { return ptr; }
+    size_t size() const { return n; }
+    T &operator[](size_t i) { return ptr[i]; }
+    const T &operator[](size_t i) const { return ptr[i]; }
+
+    // element range stored on the k-th node of numa_topology()
+    std::pair<size_t, size_t> node_range(size_t k) const { return parts[k]; }
+    size_t node_count() const { return parts.size(); }
+
+    /**
+     * Whether every partition's pages are bound to its node. Without NUMA
+     * permissions (e.g. in a container) mbind fails and placement rests on
+     * the first touch alone
+     */
+    bool node_bound() const { return bound; }
+};
+
+/**
+ * Like reduce_chunks, but each node's partition is split across that
+ * node's pinned threads only. The per-thread partials are combined within
+ * the node first and the node totals last, so the only traffic that
+ * crosses the interconnect is one value per node
+ */
+template <typename V, typename T, typename ChunkFn, typename Combine>
+T numa_reduce_chunks(const numa_array<V> &arr, T identity, const ChunkFn &fn, Combine combine) {
+    std::vector<padded<T>> nodeTotals(arr.node_count(), padded<T>{identity});
+    for_each_numa_node([&](size_t k) {
+        auto range = arr.node_range(k);
+        thread_pool &pool = *numa_pools()[k];
+        auto chunks = partition_range(range.second - range.first, (int)pool.size());
+        std::vector<padded<T>> partials(chunks.size(), padded<T>{identity});
+        pool.parallel_for(chunks.size(), [&](size_t c) {
+            partials[c].value =
+                fn(range.first + chunks[c].first, range.first + chunks[c].second);
+        });
+        T total = identity;
+        for (const auto &p : partials) total = combine(total, p.value);
+        nodeTotals[k].value = total;
+    });
+
+    T total = identity;
+    for (const auto &t : nodeTotals) total = combine(total, t.value);
+    return total;
+}
+
+inline int sum_vector(const numa_array<int> &arr) {
+    const int *data = arr.data();
+    auto chunk = [data](size_t b, size_t e) { return sum_int(data + b, e - b); };
+    return numa_reduce_chunks(arr, 0, chunk, wrapping_plus());
+}
+
+inline long long sum_vector_wide(const numa_array<int> &arr) {
+    const int *data = arr.data();
+    auto chunk = [data](size_t b, size_t e) { return sum_int_wide(data + b, e - b); };
+    return numa_reduce_chunks(arr, 0LL, chunk, std::plus<long long>());
+}
@@ -0,0 +1,42 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "numa.h"
+#include "reduce.h"
+#include "timing.h"
+
+/**
+ * Sums the same values held in a plain vector (first touched by the main
+ * thread) and in a numa_array (first touched per node), printing the
+ * topology the NUMA path found and the time of each, with a warning when
+ * the pages could not be bound to their nodes.
+ *
+ * usage: numa_sum [elements]
+ */
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (size_t)1 << 27;
+
+    for (const numa_node &node : numa_topology()) {
+        std::cout << "node " << node.id << ": " << node.cpus.size() << " cpu(s)" << std::endl;
+    }
+
+    std::vector<int> plain(n);
+    for (size_t i = 0; i < n; i++) plain[i] = (int)(i % 100);
+    numa_array<int> local(n, [](size_t i) { return (int)(i % 100); });
+
+    if (!local.node_bound()) {
+        std::cerr << "warning: mbind failed, numa array pages are placed by first touch only"
+                  << std::endl;
+    }
+
+    long long a = 0, b = 0;
+    int threads = (int)std::thread::hardware_concurrency();
+    double plainTime = 1e3 * best_seconds(5, [&] { a = sum_vector_wide(plain, threads); });
+    double numaTime = 1e3 * best_seconds(5, [&] { b = sum_vector_wide(local); });
+
+    std::cout << "plain vector: " << a << " in " << plainTime << " ms" << std::endl;
+    std::cout << "numa array:   " << b << " in " << numaTime << " ms" << std::endl;
+    std::cout << "Correct: " << (a == b ? "Yes" : "No") << std::endl;
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include "packed_sum.h"
+#include "reduce.h"
+#include "timing.h"
+
+/**
+ * sum_vector_wide over raw ints against sum_packed over the same values
+ * in each encoding, in elements per second. The values are a slow random
+ * walk around 2000, which needs 12 bits as it is, fewer as a frame of
+ * reference and fewer still as deltas. Sizes that fit in cache favour the
+ * raw sum; the packed ones only pull ahead once the raw input is far
+ * larger than the last level cache.
+ *
+ * usage: packed_bench [elements] [threads]
+ */
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (size_t)1 << 26;
+    reduce_policy policy = argc > 2 ? reduce_policy(std::atoi(argv[2]))
+                                    : reduce_policy(reduce_policy::auto_threads);
+
+    std::vector<int> values(n);
+    unsigned state = 12345;
+    int walk = 2000;
+    for (size_t i = 0; i < n; i++) {
+        state = state * 1103515245u + 12345u;
+        walk += (int)((state >> 16) % 9) - 4;
+        walk = std::min(4095, std::max(0, walk));
+        values[i] = walk;
+    }
+
+    long long expected = 0;
+    double raw = best_seconds(5, [&] { expected = sum_vector_wide(values, policy); });
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(20) << "input" << std::setw(14) << "bits/value" << std::setw(14)
+              << "Gelem/s" << std::endl;
+    std::cout << std::setw(20) << "raw" << std::setw(14) << 32.0 << std::setw(14) << n / raw / 1e9
+              << std::endl;
+
+    bool ok = true;
+    const char *names[] = {"bitpacked", "frame_of_reference", "delta"};
+    for (packing p : {packing::bitpacked, packing::frame_of_reference, packing::delta}) {
+        packed_ints packed(values, p);
+        long long sum = 0;
+        double t = best_seconds(5, [&] { sum = sum_packed(packed, policy); });
+        ok = ok && sum == expected;
+        std::cout << std::setw(20) << names[(int)p] << std::setw(14)
+                  << 8.0 * packed.bytes() / std::max<size_t>(n, 1) << std::setw(14)
+                  << n / t / 1e9 << std::endl;
+    }
+    std::cout << "Correct: " << (ok ? "Yes" : "No") << std::endl;
+    return ok ? 0 : 1;
+}
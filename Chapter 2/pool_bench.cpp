@@ -0,0 +1,59 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "reduce.h"
+#include "timing.h"
+
+/**
+ * Latency benchmark comparing sum_vector on the persistent pool against
+ * spawning and joining fresh threads on every call, across vector sizes.
+ * Reports the median time per call.
+ *
+ * usage: pool_bench [threads] [max_elements]
+ */
+int spawn_sum(std::vector<int> &arr, int numThreads) {
+    auto chunks = partition_range(arr.size(), numThreads);
+    std::vector<padded<int>> partials(chunks.size());
+    std::vector<std::thread> threads;
+    for (size_t c = 1; c < chunks.size(); c++) {
+        threads.emplace_back([&, c] {
+            partials[c].value = sum_int(arr.data() + chunks[c].first,
+                                        chunks[c].second - chunks[c].first);
+        });
+    }
+    if (!chunks.empty()) partials[0].value = sum_int(arr.data(), chunks[0].second);
+    for (auto &t : threads) t.join();
+    int total = 0;
+    for (const auto &p : partials) total += p.value;
+    return total;
+}
+
+int main(int argc, char **argv) {
+    int threads = argc > 1 ? std::atoi(argv[1])
+                           : std::max(1, (int)std::thread::hardware_concurrency());
+    size_t maxElements = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : (size_t)1 << 24;
+
+    std::cout << "threads: " << threads << ", pool workers: " << default_pool().size()
+              << std::endl;
+    std::cout << std::setw(12) << "elements" << std::setw(14) << "spawn us" << std::setw(14)
+              << "pool us" << std::setw(10) << "speedup" << std::endl;
+
+    for (size_t n = 1024; n <= maxElements; n *= 4) {
+        std::vector<int> data(n, 1);
+        int a = 0, b = 0;
+        // enough calls for a stable median without dragging on the big sizes
+        double spawn = 1e6 * median_seconds(20, [&] { a = spawn_sum(data, threads); }, 0.2);
+        double pool = 1e6 * median_seconds(20, [&] { b = sum_vector(data, threads); }, 0.2);
+        if (a != (int)n || b != (int)n) {
+            std::cerr << "wrong result at " << n << " elements" << std::endl;
+            return 1;
+        }
+        std::cout << std::fixed << std::setprecision(1) << std::setw(12) << n << std::setw(14)
+                  << spawn << std::setw(14) << pool << std::setw(10) << spawn / pool << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "accurate_sum.h"
+#include "calibration.h"
+#include "simd_sum.h"
+#include "thread_pool.h"
+
+/**
+ * Size of a cache line for padding purposes. libstdc++ only exposes
+ * hardware_destructive_interference_size from GCC 12 and warns when it
+ * leaks into a header, so x86 (where it is always 64) gets a fixed value
+ */
+#if defined(__cpp_lib_hardware_interference_size) && !defined(__x86_64__) && !defined(__i386__)
+inline constexpr std::size_t cache_line_size = std::hardware_destructive_interference_size;
+#else
+inline constexpr std::size_t cache_line_size = 64;
+#endif
+
+/**
+ * Wraps a value in its own cache line so that neighbouring slots in an
+ * array of per-thread results never share a line
+ */
+template <typename T>
+struct alignas(cache_line_size) padded {
+    T value{};
+};
+
+/**
+ * How chunks are handed to threads. Static gives every thread one equal
+ * chunk up front. Dynamic cuts the input into several smaller chunks per
+ * thread that threads claim from a shared atomic cursor as they finish, so
+ * a slow core (SMT sibling, noisy neighbour, efficiency core) just ends up
+ * reducing fewer chunks instead of holding up the whole reduction
+ */
+enum class schedule { static_chunks, dynamic };
+
+inline constexpr int dynamic_chunks_per_thread = 8;
+inline constexpr size_t dynamic_min_chunk = 2048;
+
+/**
+ * Controls how a parallel reduction is executed. With numThreads set to
+ * auto_threads the thread count and chunk size are picked per call from
+ * the input size and the machine calibration
+ */
+struct reduce_policy {
+    static constexpr int auto_threads = 0;
+
+    int numThreads = 1;
+    size_t grain = 1;        // minimum elements per chunk
+    double costScale = 1.0;  // auto mode: cost per element relative to an int sum
+    schedule sched = schedule::static_chunks;
+
+    reduce_policy() {}
+    reduce_policy(int threads) : numThreads(threads) {}
+    reduce_policy(int threads, schedule s) : numThreads(threads), sched(s) {}
+};
+
+/**
+ * Turns an automatic policy into a concrete one for n elements. With the
+ * dispatch overhead growing with the number of workers woken, the time for
+ * t threads is roughly work / t + dispatch * t / maxThreads, which is
+ * minimal at t = sqrt(work * maxThreads / dispatch). Inputs below the
+ * break-even size, where that comes out under two threads, run inline
+ */
+inline reduce_policy resolve_policy(size_t n, reduce_policy policy) {
+    if (policy.numThreads != reduce_policy::auto_threads) {
+        if (policy.numThreads < 0) policy.numThreads = 1;
+        return policy;
+    }
+    const reduce_calibration &cal = calibration();
+    int maxThreads = default_parallelism();
+    double workMicros = n * cal.elementNanos * policy.costScale * 1e-3;
+    double best = std::sqrt(workMicros * maxThreads / cal.dispatchMicros);
+    policy.numThreads = best < 2 ? 1 : std::min(maxThreads, (int)best);
+
+    // keep chunks a whole number of cache lines where the input allows
+    int parts = policy.numThreads;
+    if (policy.sched == schedule::dynamic) parts *= dynamic_chunks_per_thread;
+    size_t chunk = (n + parts - 1) / parts;
+    policy.grain = std::max(policy.grain, (chunk + 63) / 64 * 64);
+    return policy;
+}
+
+/**
+ * Splits [0, n) into at most `parts` contiguous chunks of
+ * ceil(n / parts) elements (but no fewer than `grain`), the last one
+ * possibly shorter
+ */
+inline std::vector<std::pair<size_t, size_t>> partition_range(size_t n, int parts,
+                                                              size_t grain = 1) {
+    std::vector<std::pair<size_t, size_t>> chunks;
+    if (n == 0) return chunks;
+    if (parts <= 0) parts = 1;
+    size_t chunkSize = std::max((n + parts - 1) / parts, std::max<size_t>(grain, 1));
+    chunks.reserve((n + chunkSize - 1) / chunkSize);
+    for (size_t i = 0; i < n; i += chunkSize) {
+        chunks.emplace_back(i, std::min(i + chunkSize, n));
+    }
+    return chunks;
+}
+
+/**
+ * The chunks a resolved policy reduces [0, n) in
+ */
+inline std::vector<std::pair<size_t, size_t>> policy_chunks(size_t n, const reduce_policy &policy) {
+    int parts = policy.numThreads;
+    size_t grain = policy.grain;
+    if (policy.sched == schedule::dynamic) {
+        parts *= dynamic_chunks_per_thread;
+        grain = std::max(grain, dynamic_min_chunk);
+    }
+    return partition_range(n, parts, grain);
+}
+
+/**
+ * One chunk of a parallel reduction. The chunk function folds its range
+ * into a local (register) accumulator and the worker publishes the partial
+ * once at the end; the worker itself is padded to a cache line so the
+ * published partials of different threads never ping-pong between cores
+ */
+template <typename T, typename ChunkFn>
+struct alignas(cache_line_size) ReduceWork {
+    std::pair<size_t, size_t> bounds;
+    const ChunkFn *fn;
+    T result;
+
+    ReduceWork(size_t s, size_t e, const ChunkFn &fn_, const T &identity)
+        : bounds({s, e}), fn(&fn_), result(identity) {}
+
+    void operator()() { result = (*fn)(bounds.first, bounds.second); }
+};
+
+/**
+ * Runs fn(begin, end) -> T over the chunks of [0, n) in parallel and folds
+ * the partials left to right with combine. This is the building block the
+ * typed reductions plug their inner kernels into
+ */
+template <typename T, typename ChunkFn, typename Combine>
+T reduce_chunks(size_t n, T identity, const ChunkFn &fn, Combine combine,
+                reduce_policy policy = reduce_policy::auto_threads) {
+    if (n == 0) return identity;
+
+    policy = resolve_policy(n, policy);
+
+    // Create worker objects first and keep them alive
+    std::vector<ReduceWork<T, ChunkFn>> workers;
+    auto chunks = policy_chunks(n, policy);
+    workers.reserve(chunks.size());
+    for (const auto &c : chunks) {
+        workers.emplace_back(c.first, c.second, fn, identity);
+    }
+
+    // the pool's parked workers claim chunks from parallel_for's atomic
+    // cursor, with the calling thread reducing chunks alongside them instead
+    // of idling; with one chunk per thread that is the static schedule
+    default_pool().parallel_for(
+        workers.size(), [&](size_t i) { workers[i](); }, policy.numThreads);
+
+    T total = identity;
+    for (const auto &w : workers) {
+        total = combine(total, w.result);
+    }
+    return total;
+}
+
+/**
+ * Runs fn(begin, end) over the chunks of [0, n), for element-wise ops
+ * that write their results instead of reducing them
+ */
+template <typename ChunkFn>
+void for_each_chunk(size_t n, const ChunkFn &fn, reduce_policy policy) {
+    if (n == 0) return;
+    policy = resolve_policy(n, policy);
+    auto chunks = policy_chunks(n, policy);
+    default_pool().parallel_for(
+        chunks.size(), [&](size_t c) { fn(chunks[c].first, chunks[c].second); },
+        policy.numThreads);
+}
+
+/**
+ * Reduces [first, last) with an associative binary op. Chunks are combined
+ * left to right, so op need not be commutative; identity must be a neutral
+ * element for op since every chunk starts from it
+ */
+template <typename It, typename T, typename BinaryOp>
+T parallel_reduce(It first, It last, T identity, BinaryOp op,
+                  reduce_policy policy = reduce_policy::auto_threads) {
+    size_t n = (size_t)std::distance(first, last);
+    auto chunk = [&](size_t b, size_t e) {
+        // for non random access iterators each worker walks to its own
+        // start, which costs no more than the reduction itself
+        It it = first;
+        std::advance(it, b);
+        T acc = identity;
+        for (size_t i = b; i < e; ++i, ++it) {
+            acc = op(acc, *it);
+        }
+        return acc;
+    };
+    return reduce_chunks(n, identity, chunk, op, policy);
+}
+
+template <typename Range, typename T, typename BinaryOp>
+T parallel_reduce(const Range &range, T identity, BinaryOp op,
+                  reduce_policy policy = reduce_policy::auto_threads) {
+    return parallel_reduce(std::begin(range), std::end(range), identity, op, policy);
+}
+
+/**
+ * Sums ints with wrap-around on overflow. A plain thread count converts to
+ * a static policy; reduce_policy::auto_threads picks threads and chunking
+ * automatically
+ */
+inline int sum_vector(std::vector<int> &arr,
+                      reduce_policy policy = reduce_policy::auto_threads) {
+    const int *data = arr.data();
+    auto chunk = [data](size_t b, size_t e) { return sum_int(data + b, e - b); };
+    return reduce_chunks(arr.size(), 0, chunk, wrapping_plus(), policy);
+}
+
+/**
+ * Overflow-safe sum of ints, accumulated in 64 bits
+ */
+inline long long sum_vector_wide(const std::vector<int> &arr, reduce_policy policy) {
+    const int *data = arr.data();
+    auto chunk = [data](size_t b, size_t e) { return sum_int_wide(data + b, e - b); };
+    return reduce_chunks(arr.size(), 0LL, chunk, std::plus<long long>(), policy);
+}
+
+#ifdef __SIZEOF_INT128__
+/**
+ * Overflow-safe sum of int64 values, accumulated in 128 bits
+ */
+inline int128 sum_vector_wide(const std::vector<long long> &arr, reduce_policy policy) {
+    const long long *data = arr.data();
+    auto chunk = [data](size_t b, size_t e) { return sum_int64_wide(data + b, e - b); };
+    policy.costScale *= 2;
+    return reduce_chunks(arr.size(), (int128)0, chunk, std::plus<int128>(), policy);
+}
+#endif
+
+/**
+ * Deterministic mode: chunks only decide which thread sums which fixed
+ * blocks, so the result doesn't depend on the policy
+ */
+template <typename T>
+double sum_fp_deterministic(const T *data, size_t n, reduce_policy policy) {
+    if (n == 0) return 0;
+    std::vector<double> sums(deterministic_blocks(n));
+    policy = resolve_policy(n, policy);
+    auto chunks = policy_chunks(n, policy);
+    // a chunk takes the blocks starting inside it
+    default_pool().parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            size_t first = deterministic_blocks(chunks[c].first);
+            size_t last = deterministic_blocks(chunks[c].second);
+            sum_blocks8(data, n, first, last, sums.data() + first);
+        },
+        policy.numThreads);
+    return sum_block_tree(sums.data(), sums.size());
+}
+
+template <typename T>
+double sum_fp_vector(const std::vector<T> &arr, reduce_policy policy, sum_mode mode) {
+    if (mode == sum_mode::deterministic) {
+        policy.costScale *= sizeof(T) / (double)sizeof(int);
+        return sum_fp_deterministic(arr.data(), arr.size(), policy);
+    }
+    const T *data = arr.data();
+    auto chunk = [data, mode](size_t b, size_t e) { return sum_fp(data + b, e - b, mode); };
+    policy.costScale *= sizeof(T) / (double)sizeof(int) * (mode == sum_mode::fast ? 1 : 2);
+    // chunk partials are always merged with their error terms, so the
+    // thread count doesn't cost the compensated modes any accuracy
+    return reduce_chunks(arr.size(), compensated{}, chunk, merge_compensated, policy).value();
+}
+
+/**
+ * Floating point sums are accumulated in double with the given mode
+ */
+inline double sum_vector(const std::vector<double> &arr, reduce_policy policy,
+                         sum_mode mode = sum_mode::neumaier) {
+    return sum_fp_vector(arr, policy, mode);
+}
+
+inline double sum_vector(const std::vector<float> &arr, reduce_policy policy,
+                         sum_mode mode = sum_mode::neumaier) {
+    return sum_fp_vector(arr, policy, mode);
+}
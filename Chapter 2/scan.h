@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "reduce.h"
+#include "simd_sum.h"
+#include "thread_pool.h"
+
+/**
+ * Parallel inclusive and exclusive prefix sums using reduce-then-scan:
+ * the first pass sums every chunk (the same chunking sum_vector uses), a
+ * short sequential scan over the chunk totals gives each chunk its
+ * starting offset, and the second pass scans every chunk from its offset.
+ * Integer scans wrap on overflow like sum_vector, within chunks and across
+ * them; int inputs use SIMD in-chunk scans, other arithmetic types the
+ * scalar loop. Scanning in place (out == in) is allowed
+ */
+
+// scans n ints starting from carry; exclusive scans store the running
+// total before each element instead of after it. Returns the final total
+inline int scan_int_scalar(const int *in, int *out, size_t n, int carry, bool exclusive) {
+    unsigned acc = (unsigned)carry;
+    for (size_t i = 0; i < n; i++) {
+        unsigned v = (unsigned)in[i];
+        if (exclusive) out[i] = (int)acc;
+        acc += v;
+        if (!exclusive) out[i] = (int)acc;
+    }
+    return (int)acc;
+}
+
+#ifdef SIMD_SUM_X86
+SIMD_TARGET("sse2")
+inline int scan_int_sse2(const int *in, int *out, size_t n, int carry, bool exclusive) {
+    __m128i c = _mm_set1_epi32(carry);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        // log-step scan within the register: add the vector shifted by
+        // one, then by two elements
+        __m128i v = _mm_loadu_si128((const __m128i *)(in + i));
+        __m128i x = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, c);
+        _mm_storeu_si128((__m128i *)(out + i), exclusive ? _mm_sub_epi32(x, v) : x);
+        c = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+    }
+    return scan_int_scalar(in + i, out + i, n - i, _mm_cvtsi128_si32(c), exclusive);
+}
+
+SIMD_TARGET("avx2")
+inline int scan_int_avx2(const int *in, int *out, size_t n, int carry, bool exclusive) {
+    __m256i c = _mm256_set1_epi32(carry);
+    const __m256i last = _mm256_set1_epi32(7);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(in + i));
+        // scan each 128 bit half, then carry the low half's total into the
+        // high half
+        __m256i x = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+        __m256i lowTotal = _mm256_shuffle_epi32(_mm256_permute2x128_si256(x, x, 0x08), 0xff);
+        x = _mm256_add_epi32(x, lowTotal);
+        x = _mm256_add_epi32(x, c);
+        _mm256_storeu_si256((__m256i *)(out + i), exclusive ? _mm256_sub_epi32(x, v) : x);
+        c = _mm256_permutevar8x32_epi32(x, last);
+    }
+    return scan_int_scalar(in + i, out + i, n - i, _mm256_cvtsi256_si32(c), exclusive);
+}
+#endif
+
+inline int scan_int(const int *in, int *out, size_t n, int carry, bool exclusive) {
+#ifdef SIMD_SUM_X86
+    switch (active_simd_level()) {
+        case simd_level::avx512:
+        case simd_level::avx2:
+            return scan_int_avx2(in, out, n, carry, exclusive);
+        case simd_level::sse2:
+            return scan_int_sse2(in, out, n, carry, exclusive);
+        default:
+            break;
+    }
+#endif
+    return scan_int_scalar(in, out, n, carry, exclusive);
+}
+
+template <typename T>
+T scan_chunk(const T *in, T *out, size_t n, T carry, bool exclusive) {
+    if constexpr (std::is_same_v<T, int>) {
+        return scan_int(in, out, n, carry, exclusive);
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            T v = in[i];
+            if (exclusive) out[i] = carry;
+            carry = wrapping_plus()(carry, v);
+            if (!exclusive) out[i] = carry;
+        }
+        return carry;
+    }
+}
+
+template <typename T>
+T sum_chunk(const T *p, size_t n) {
+    if constexpr (std::is_same_v<T, int>) {
+        return sum_int(p, n);
+    } else {
+        T acc = T();
+        for (size_t i = 0; i < n; i++) acc = wrapping_plus()(acc, p[i]);
+        return acc;
+    }
+}
+
+/**
+ * Scans n values from in to out starting at init, in parallel. Returns the
+ * total (init plus every input)
+ */
+template <typename T>
+T parallel_scan(const T *in, T *out, size_t n, T init, bool exclusive,
+                reduce_policy policy = reduce_policy::auto_threads) {
+    if (n == 0) return init;
+    // a scan touches every element twice, so it's costlier than a sum
+    policy.costScale *= 2 * sizeof(T) / (double)sizeof(int);
+    policy = resolve_policy(n, policy);
+    auto chunks = policy_chunks(n, policy);
+    if (chunks.size() == 1) return scan_chunk(in, out, n, init, exclusive);
+
+    thread_pool &pool = default_pool();
+    std::vector<padded<T>> offsets(chunks.size());
+    pool.parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            offsets[c].value = sum_chunk(in + chunks[c].first, chunks[c].second - chunks[c].first);
+        },
+        policy.numThreads);
+
+    T running = init;
+    for (auto &o : offsets) {
+        T chunkTotal = o.value;
+        o.value = running;
+        running = wrapping_plus()(running, chunkTotal);
+    }
+
+    pool.parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            size_t b = chunks[c].first;
+            scan_chunk(in + b, out + b, chunks[c].second - b, offsets[c].value, exclusive);
+        },
+        policy.numThreads);
+    return running;
+}
+
+template <typename T>
+std::vector<T> inclusive_scan_vector(const std::vector<T> &in,
+                                     reduce_policy policy = reduce_policy::auto_threads) {
+    std::vector<T> out(in.size());
+    parallel_scan(in.data(), out.data(), in.size(), T(), false, policy);
+    return out;
+}
+
+/**
+ * out[i] is the sum of in[0..i), so out[0] is 0; handy for turning
+ * bucket sizes into bucket offsets
+ */
+template <typename T>
+std::vector<T> exclusive_scan_vector(const std::vector<T> &in,
+                                     reduce_policy policy = reduce_policy::auto_threads) {
+    std::vector<T> out(in.size());
+    parallel_scan(in.data(), out.data(), in.size(), T(), true, policy);
+    return out;
+}
@@ -0,0 +1,48 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+#include "scan.h"
+#include "timing.h"
+
+/**
+ * Scan throughput against memcpy of the same array, which is the
+ * bandwidth a scan (read n, write n) can at best approach. Checks both
+ * scan flavours against std::inclusive_scan/exclusive_scan.
+ *
+ * usage: scan_bench [elements] [threads]
+ */
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 100000000;
+    reduce_policy policy = argc > 2 ? reduce_policy(std::atoi(argv[2]))
+                                    : reduce_policy(reduce_policy::auto_threads);
+
+    std::vector<int> in(n), out(n), expected(n);
+    for (size_t i = 0; i < n; i++) in[i] = (int)(i % 13) - 6;
+
+    std::inclusive_scan(in.begin(), in.end(), expected.begin());
+    parallel_scan(in.data(), out.data(), n, 0, false, policy);
+    bool inclusiveOk = out == expected;
+    std::exclusive_scan(in.begin(), in.end(), expected.begin(), 0);
+    parallel_scan(in.data(), out.data(), n, 0, true, policy);
+    bool exclusiveOk = out == expected;
+    std::cout << "elements: " << n << ", inclusive " << (inclusiveOk ? "ok" : "WRONG")
+              << ", exclusive " << (exclusiveOk ? "ok" : "WRONG") << std::endl;
+
+    double bytes = 2.0 * n * sizeof(int);
+    double copy = best_seconds(5, [&] { std::memcpy(out.data(), in.data(), n * sizeof(int)); });
+    double seq = best_seconds(5, [&] { std::inclusive_scan(in.begin(), in.end(), out.begin()); });
+    double par =
+        best_seconds(5, [&] { parallel_scan(in.data(), out.data(), n, 0, false, policy); });
+
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << std::setw(16) << "memcpy: " << bytes / copy / 1e9 << " GB/s" << std::endl;
+    std::cout << std::setw(16) << "std scan: " << bytes / seq / 1e9 << " GB/s" << std::endl;
+    std::cout << std::setw(16) << "parallel scan: " << bytes / par / 1e9 << " GB/s ("
+              << 100 * copy / par << "% of memcpy)" << std::endl;
+    return inclusiveOk && exclusiveOk ? 0 : 1;
+}
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "reduce.h"
+
+/**
+ * Compares static and dynamic scheduling when one thread is slower than
+ * the rest. The first thread to pick up a chunk plays the slow core: it
+ * reduces every chunk it gets `slowdown` times over. With static chunks the
+ * whole reduction waits on it; with dynamic chunks the other threads take
+ * over the remaining work.
+ *
+ * usage: schedule_bench [threads] [elements] [slowdown]
+ */
+int main(int argc, char **argv) {
+    int threads = argc > 1 ? std::atoi(argv[1])
+                           : std::max(2, (int)std::thread::hardware_concurrency());
+    size_t n = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : (size_t)1 << 25;
+    int slowdown = argc > 3 ? std::atoi(argv[3]) : 4;
+
+    std::vector<int> data(n, 1);
+    std::atomic<std::thread::id> slowThread{};
+    auto chunk = [&](size_t b, size_t e) {
+        std::thread::id none{}, self = std::this_thread::get_id();
+        slowThread.compare_exchange_strong(none, self);
+        int reps = slowThread.load() == self ? slowdown : 1;
+        int sum = 0;
+        for (int r = 0; r < reps; r++) {
+            sum = sum_int(data.data() + b, e - b);
+            // keep the repeated sums from being folded into one
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+        }
+        return sum;
+    };
+
+    std::cout << "threads: " << threads << ", elements: " << n << ", slow thread runs "
+              << slowdown << "x slower" << std::endl;
+    for (schedule s : {schedule::static_chunks, schedule::dynamic}) {
+        double best = 1e30;
+        for (int rep = 0; rep < 5; rep++) {
+            slowThread = std::thread::id{};
+            auto start = std::chrono::steady_clock::now();
+            int total = reduce_chunks(n, 0, chunk, wrapping_plus(), reduce_policy(threads, s));
+            std::chrono::duration<double, std::milli> d = std::chrono::steady_clock::now() - start;
+            if (total != (int)n) {
+                std::cerr << "wrong result" << std::endl;
+                return 1;
+            }
+            best = std::min(best, d.count());
+        }
+        std::cout << std::setw(8) << (s == schedule::dynamic ? "dynamic" : "static") << ": "
+                  << std::fixed << std::setprecision(2) << best << " ms" << std::endl;
+    }
+    return 0;
+}
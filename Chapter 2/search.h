@@ -0,0 +1,289 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+#include "reduce.h"
+#include "simd_sum.h"
+#include "thread_pool.h"
+
+/**
+ * Parallel searches with early exit on the sum_vector chunking. Workers
+ * scan their chunk in blocks and share an atomic "best index": before each
+ * block they check it and stop once a match at or before the block start
+ * is known, and a match lowers it with a CAS loop. The lowest matching
+ * index always wins, so results match a sequential find_if. Comparisons of
+ * int and double arrays against a value get SIMD kernels that compare a
+ * register at a time and turn the result into a bitmask
+ */
+inline constexpr size_t search_block = 4096;
+
+/**
+ * Runs find(b, e) -> first match in [b, e) or e over the chunks of [0, n)
+ * and returns the lowest match, or n if there is none
+ */
+template <typename FindFn>
+size_t search_chunks(size_t n, const FindFn &find, reduce_policy policy) {
+    if (n == 0) return 0;
+    policy = resolve_policy(n, policy);
+    auto chunks = policy_chunks(n, policy);
+    std::atomic<size_t> best{n};
+
+    default_pool().parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            for (size_t b = chunks[c].first; b < chunks[c].second; b += search_block) {
+                // anything found from here on would lose to the current best
+                if (best.load(std::memory_order_relaxed) <= b) return;
+                size_t e = std::min(chunks[c].second, b + search_block);
+                size_t hit = find(b, e);
+                if (hit == e) continue;
+                size_t current = best.load(std::memory_order_relaxed);
+                while (hit < current &&
+                       !best.compare_exchange_weak(current, hit, std::memory_order_relaxed)) {
+                }
+                return;
+            }
+        },
+        policy.numThreads);
+    return best.load(std::memory_order_relaxed);
+}
+
+/**
+ * Index of the first element pred accepts, or arr.size()
+ */
+template <typename T, typename Pred>
+size_t parallel_find_if(const std::vector<T> &arr, Pred pred,
+                        reduce_policy policy = reduce_policy::auto_threads) {
+    const T *data = arr.data();
+    auto find = [data, &pred](size_t b, size_t e) {
+        for (size_t i = b; i < e; i++) {
+            if (pred(data[i])) return i;
+        }
+        return e;
+    };
+    return search_chunks(arr.size(), find, policy);
+}
+
+template <typename T, typename Pred>
+bool parallel_any_of(const std::vector<T> &arr, Pred pred,
+                     reduce_policy policy = reduce_policy::auto_threads) {
+    return parallel_find_if(arr, pred, policy) != arr.size();
+}
+
+template <typename T, typename Pred>
+bool parallel_all_of(const std::vector<T> &arr, Pred pred,
+                     reduce_policy policy = reduce_policy::auto_threads) {
+    auto fails = [&pred](const T &v) { return !pred(v); };
+    return parallel_find_if(arr, fails, policy) == arr.size();
+}
+
+template <typename T, typename Pred>
+bool parallel_none_of(const std::vector<T> &arr, Pred pred,
+                      reduce_policy policy = reduce_policy::auto_threads) {
+    return !parallel_any_of(arr, pred, policy);
+}
+
+// ---- SIMD compare kernels ---------------------------------------------
+
+/**
+ * element <op> value
+ */
+enum class compare { eq, ne, lt, le, gt, ge };
+
+template <compare Op, typename T>
+bool compare_holds(T x, T v) {
+    switch (Op) {
+        case compare::eq:
+            return x == v;
+        case compare::ne:
+            return x != v;
+        case compare::lt:
+            return x < v;
+        case compare::le:
+            return x <= v;
+        case compare::gt:
+            return x > v;
+        default:
+            return x >= v;
+    }
+}
+
+template <compare Op, typename T>
+size_t find_compare_scalar(const T *p, size_t n, T v) {
+    for (size_t i = 0; i < n; i++) {
+        if (compare_holds<Op>(p[i], v)) return i;
+    }
+    return n;
+}
+
+#ifdef SIMD_SUM_X86
+// 8 bits, one per int lane
+template <compare Op>
+SIMD_TARGET("avx2") unsigned compare_mask_avx2(__m256i x, __m256i v) {
+    __m256i m;
+    if (Op == compare::eq || Op == compare::ne) {
+        m = _mm256_cmpeq_epi32(x, v);
+    } else if (Op == compare::lt || Op == compare::ge) {
+        m = _mm256_cmpgt_epi32(v, x);
+    } else {
+        m = _mm256_cmpgt_epi32(x, v);
+    }
+    unsigned bits = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(m));
+    // ne, ge and le are the complements of eq, lt and gt
+    if (Op == compare::ne || Op == compare::ge || Op == compare::le) bits ^= 0xffu;
+    return bits;
+}
+
+template <compare Op>
+SIMD_TARGET("avx2") size_t find_compare_avx2(const int *p, size_t n, int value) {
+    __m256i v = _mm256_set1_epi32(value);
+    size_t i = 0;
+    // 32 elements per test keeps the loop branch off the critical path
+    for (; i + 32 <= n; i += 32) {
+        unsigned m0 = compare_mask_avx2<Op>(_mm256_loadu_si256((const __m256i *)(p + i)), v);
+        unsigned m1 = compare_mask_avx2<Op>(_mm256_loadu_si256((const __m256i *)(p + i + 8)), v);
+        unsigned m2 = compare_mask_avx2<Op>(_mm256_loadu_si256((const __m256i *)(p + i + 16)), v);
+        unsigned m3 = compare_mask_avx2<Op>(_mm256_loadu_si256((const __m256i *)(p + i + 24)), v);
+        unsigned bits = m0 | m1 << 8 | m2 << 16 | m3 << 24;
+        if (bits) return i + (size_t)__builtin_ctz(bits);
+    }
+    return i + find_compare_scalar<Op>(p + i, n - i, value);
+}
+
+template <compare Op>
+constexpr int avx512_cmp_predicate() {
+    switch (Op) {
+        case compare::eq:
+            return _MM_CMPINT_EQ;
+        case compare::ne:
+            return _MM_CMPINT_NE;
+        case compare::lt:
+            return _MM_CMPINT_LT;
+        case compare::le:
+            return _MM_CMPINT_LE;
+        case compare::gt:
+            return _MM_CMPINT_NLE;
+        default:
+            return _MM_CMPINT_NLT;
+    }
+}
+
+template <compare Op>
+SIMD_TARGET("avx512f") size_t find_compare_avx512(const int *p, size_t n, int value) {
+    constexpr int pred = avx512_cmp_predicate<Op>();
+    __m512i v = _mm512_set1_epi32(value);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        unsigned m0 = _mm512_cmp_epi32_mask(_mm512_loadu_si512(p + i), v, pred);
+        unsigned m1 = _mm512_cmp_epi32_mask(_mm512_loadu_si512(p + i + 16), v, pred);
+        unsigned bits = m0 | m1 << 16;
+        if (bits) return i + (size_t)__builtin_ctz(bits);
+    }
+    // masked tail, like sum_int_avx512
+    for (; i < n; i += 16) {
+        size_t left = n - i < 16 ? n - i : 16;
+        __mmask16 m = (__mmask16)((1u << left) - 1);
+        __m512i x = _mm512_maskz_loadu_epi32(m, p + i);
+        unsigned bits = _mm512_mask_cmp_epi32_mask(m, x, v, pred);
+        if (bits) return i + (size_t)__builtin_ctz(bits);
+    }
+    return n;
+}
+
+template <compare Op>
+constexpr int avx_cmp_pd_predicate() {
+    switch (Op) {
+        case compare::eq:
+            return _CMP_EQ_OQ;
+        case compare::ne:
+            return _CMP_NEQ_UQ;  // NaN != v, as in C++
+        case compare::lt:
+            return _CMP_LT_OQ;
+        case compare::le:
+            return _CMP_LE_OQ;
+        case compare::gt:
+            return _CMP_GT_OQ;
+        default:
+            return _CMP_GE_OQ;
+    }
+}
+
+template <compare Op>
+SIMD_TARGET("avx2") size_t find_compare_avx2(const double *p, size_t n, double value) {
+    constexpr int pred = avx_cmp_pd_predicate<Op>();
+    __m256d v = _mm256_set1_pd(value);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        unsigned m0 = (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(p + i), v, pred));
+        unsigned m1 =
+            (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(p + i + 4), v, pred));
+        unsigned m2 =
+            (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(p + i + 8), v, pred));
+        unsigned m3 =
+            (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(p + i + 12), v, pred));
+        unsigned bits = m0 | m1 << 4 | m2 << 8 | m3 << 12;
+        if (bits) return i + (size_t)__builtin_ctz(bits);
+    }
+    return i + find_compare_scalar<Op>(p + i, n - i, value);
+}
+#endif
+
+template <compare Op>
+size_t find_compare(const int *p, size_t n, int value) {
+#ifdef SIMD_SUM_X86
+    switch (active_simd_level()) {
+        case simd_level::avx512:
+            return find_compare_avx512<Op>(p, n, value);
+        case simd_level::avx2:
+            return find_compare_avx2<Op>(p, n, value);
+        default:
+            break;
+    }
+#endif
+    return find_compare_scalar<Op>(p, n, value);
+}
+
+template <compare Op>
+size_t find_compare(const double *p, size_t n, double value) {
+#ifdef SIMD_SUM_X86
+    if (active_simd_level() >= simd_level::avx2) return find_compare_avx2<Op>(p, n, value);
+#endif
+    return find_compare_scalar<Op>(p, n, value);
+}
+
+template <compare Op, typename T>
+size_t parallel_find_compare(const std::vector<T> &arr, T value, reduce_policy policy) {
+    const T *data = arr.data();
+    auto find = [data, value](size_t b, size_t e) {
+        return b + find_compare<Op>(data + b, e - b, value);
+    };
+    return search_chunks(arr.size(), find, policy);
+}
+
+/**
+ * Index of the first element x with x <op> value, or arr.size()
+ */
+template <typename T>
+size_t parallel_find(const std::vector<T> &arr, compare op, T value,
+                     reduce_policy policy = reduce_policy::auto_threads) {
+    static_assert(std::is_same_v<T, int> || std::is_same_v<T, double>,
+                  "SIMD search is for int and double; use parallel_find_if otherwise");
+    switch (op) {
+        case compare::eq:
+            return parallel_find_compare<compare::eq>(arr, value, policy);
+        case compare::ne:
+            return parallel_find_compare<compare::ne>(arr, value, policy);
+        case compare::lt:
+            return parallel_find_compare<compare::lt>(arr, value, policy);
+        case compare::le:
+            return parallel_find_compare<compare::le>(arr, value, policy);
+        case compare::gt:
+            return parallel_find_compare<compare::gt>(arr, value, policy);
+        default:
+            return parallel_find_compare<compare::ge>(arr, value, policy);
+    }
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "reduce.h"
+#include "thread_pool.h"
+
+/**
+ * Order statistics without sorting the input, on the sum_vector chunking.
+ *   - top-k: every chunk keeps its k best elements in a bounded heap whose
+ *     root is the worst one kept, so most elements cost one comparison;
+ *     the chunks' heaps are merged and sorted at the end
+ *   - selection: a sorted, evenly strided sample brackets the wanted ranks
+ *     with two pivots, one parallel pass counts the elements below the
+ *     bracket and gathers the few inside it, and nth_element finishes on
+ *     those. A bracket that misses is widened and the pass repeated, ending
+ *     at worst with the whole input as candidates
+ * Inputs are left untouched. Floating point inputs must not contain NaN
+ */
+template <typename T, typename Compare>
+std::vector<T> bounded_top_k(const T *p, size_t n, size_t k, Compare comp) {
+    std::vector<T> heap;
+    if (k == 0) return heap;
+    heap.reserve(k);
+    // with comp as the heap order the root is the element that loses to
+    // every other kept one
+    for (size_t i = 0; i < n; i++) {
+        if (heap.size() < k) {
+            heap.push_back(p[i]);
+            std::push_heap(heap.begin(), heap.end(), comp);
+        } else if (comp(p[i], heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), comp);
+            heap.back() = p[i];
+            std::push_heap(heap.begin(), heap.end(), comp);
+        }
+    }
+    return heap;
+}
+
+/**
+ * The k elements that come first under comp, in that order: the k largest
+ * for std::greater (the default), the k smallest for std::less. Fewer if
+ * arr is shorter than k
+ */
+template <typename T, typename Compare = std::greater<T>>
+std::vector<T> parallel_top_k(const std::vector<T> &arr, size_t k, Compare comp = Compare(),
+                              reduce_policy policy = reduce_policy::auto_threads) {
+    k = std::min(k, arr.size());
+    if (k == 0) return {};
+    const T *data = arr.data();
+    policy = resolve_policy(arr.size(), policy);
+    auto chunks = policy_chunks(arr.size(), policy);
+    std::vector<std::vector<T>> heaps(chunks.size());
+    default_pool().parallel_for(
+        chunks.size(),
+        [&](size_t c) {
+            size_t b = chunks[c].first;
+            heaps[c] = bounded_top_k(data + b, chunks[c].second - b, k, comp);
+        },
+        policy.numThreads);
+
+    std::vector<T> merged;
+    for (auto &h : heaps) merged.insert(merged.end(), h.begin(), h.end());
+    std::partial_sort(merged.begin(), merged.begin() + k, merged.end(), comp);
+    merged.resize(k);
+    return merged;
+}
+
+template <typename T>
+std::vector<T> parallel_bottom_k(const std::vector<T> &arr, size_t k,
+                                 reduce_policy policy = reduce_policy::auto_threads) {
+    return parallel_top_k(arr, k, std::less<T>(), policy);
+}
+
+inline constexpr size_t selection_sample = 1 << 14;
+
+/**
+ * Values of sorted(arr)[first] and sorted(arr)[last], first <= last
+ */
+template <typename T>
+std::pair<T, T> parallel_select_pair(const std::vector<T> &arr, size_t first, size_t last,
+                                     reduce_policy policy) {
+    size_t n = arr.size();
+    if (first > last || last >= n) throw std::out_of_range("selection rank out of range");
+    const T *data = arr.data();
+    policy = resolve_policy(n, policy);
+    auto chunks = policy_chunks(n, policy);
+
+    size_t s = std::min(n, selection_sample);
+    std::vector<T> sample(s);
+    for (size_t i = 0; i < s; i++) sample[i] = data[i * n / s];
+    std::sort(sample.begin(), sample.end());
+    // the ranks' expected positions in the sample, and a margin of a few
+    // standard deviations of the sample rank around them
+    size_t lo = first * s / n, hi = last * s / n;
+    size_t margin = 4 * (size_t)std::sqrt((double)s) + 1;
+
+    std::vector<size_t> below(chunks.size());
+    std::vector<std::vector<T>> inside(chunks.size());
+    for (;;) {
+        // a pivot off the end of the sample means no bound on that side
+        bool hasLow = lo >= margin, hasHigh = hi + margin < s;
+        T low = hasLow ? sample[lo - margin] : T(), high = hasHigh ? sample[hi + margin] : T();
+        default_pool().parallel_for(
+            chunks.size(),
+            [&](size_t c) {
+                size_t count = 0;
+                std::vector<T> kept;
+                for (size_t i = chunks[c].first; i < chunks[c].second; i++) {
+                    const T &v = data[i];
+                    if (hasLow && v < low) {
+                        count++;
+                    } else if (!hasHigh || !(high < v)) {
+                        kept.push_back(v);
+                    }
+                }
+                below[c] = count;
+                inside[c] = std::move(kept);
+            },
+            policy.numThreads);
+
+        size_t skipped = 0, found = 0;
+        for (size_t c = 0; c < chunks.size(); c++) {
+            skipped += below[c];
+            found += inside[c].size();
+        }
+        if (skipped <= first && last < skipped + found) {
+            std::vector<T> candidates;
+            candidates.reserve(found);
+            for (auto &v : inside) candidates.insert(candidates.end(), v.begin(), v.end());
+            auto nth = candidates.begin() + (first - skipped);
+            std::nth_element(candidates.begin(), nth, candidates.end());
+            if (last == first) return {*nth, *nth};
+            // everything after nth is already no smaller than it
+            auto nth2 = candidates.begin() + (last - skipped);
+            std::nth_element(nth + 1, nth2, candidates.end());
+            return {*nth, *nth2};
+        }
+        // the bracket missed (an unlucky sample); widen it and go again
+        margin *= 4;
+    }
+}
+
+/**
+ * Value of sorted(arr)[rank], like std::nth_element without reordering arr
+ */
+template <typename T>
+T parallel_nth_element(const std::vector<T> &arr, size_t rank,
+                       reduce_policy policy = reduce_policy::auto_threads) {
+    return parallel_select_pair(arr, rank, rank, policy).first;
+}
+
+/**
+ * The q-quantile, 0 <= q <= 1, interpolating linearly between the two
+ * closest ranks (q = 0.5 is the median)
+ */
+template <typename T>
+double parallel_quantile(const std::vector<T> &arr, double q,
+                         reduce_policy policy = reduce_policy::auto_threads) {
+    if (!(q >= 0 && q <= 1)) throw std::invalid_argument("quantile must be in [0, 1]");
+    if (arr.empty()) throw std::out_of_range("quantile of an empty vector");
+    double h = q * (double)(arr.size() - 1);
+    size_t below = (size_t)std::floor(h);
+    size_t above = std::min(below + 1, arr.size() - 1);
+    auto [a, b] = parallel_select_pair(arr, below, above, policy);
+    return (double)a + (h - (double)below) * ((double)b - (double)a);
+}
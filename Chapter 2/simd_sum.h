@@ -0,0 +1,180 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#include <immintrin.h>
+#define SIMD_SUM_X86 1
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/**
+ * Explicitly vectorized summation kernels with runtime CPU dispatch.
+ * Each kernel keeps several independent vector accumulators so the adds of
+ * consecutive iterations don't wait on each other, and the widest ISA the
+ * CPU and OS support is picked once through CPUID. Non x86 builds only get
+ * the scalar kernel
+ */
+enum class simd_level { scalar, sse2, avx2, avx512 };
+
+inline const char *simd_level_name(simd_level l) {
+    switch (l) {
+        case simd_level::sse2:
+            return "sse2";
+        case simd_level::avx2:
+            return "avx2";
+        case simd_level::avx512:
+            return "avx512";
+        default:
+            return "scalar";
+    }
+}
+
+inline simd_level detect_simd_level() {
+#ifdef SIMD_SUM_X86
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return simd_level::scalar;
+    bool sse2 = edx & (1u << 26);
+    bool osxsave = ecx & (1u << 27);
+    bool avx = ecx & (1u << 28);
+    if (!sse2) return simd_level::scalar;
+    if (!osxsave || !avx) return simd_level::sse2;
+
+    // the OS has to save the wider registers on context switch too
+    unsigned xcr0_lo, xcr0_hi;
+    __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 0x6) != 0x6) return simd_level::sse2;
+
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) return simd_level::sse2;
+    bool avx2 = ebx & (1u << 5);
+    bool avx512f = ebx & (1u << 16);
+    if (avx512f && (xcr0_lo & 0xe6) == 0xe6) return simd_level::avx512;
+    if (avx2) return simd_level::avx2;
+    return simd_level::sse2;
+#else
+    return simd_level::scalar;
+#endif
+}
+
+inline simd_level &active_simd_level() {
+    static simd_level level = detect_simd_level();
+    return level;
+}
+
+/**
+ * Lowers the ISA used by the dispatching kernels (e.g. to compare them in a
+ * benchmark). Asking for more than the CPU supports is clamped
+ */
+inline void set_simd_level(simd_level l) {
+    simd_level detected = detect_simd_level();
+    active_simd_level() = l > detected ? detected : l;
+}
+
+// int sums wrap like the two's complement adds the vector units do, which
+// the scalar path gets by accumulating in unsigned
+inline int sum_int_scalar(const int *p, size_t n) {
+    unsigned a0 = 0, a1 = 0, a2 = 0, a3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 += (unsigned)p[i];
+        a1 += (unsigned)p[i + 1];
+        a2 += (unsigned)p[i + 2];
+        a3 += (unsigned)p[i + 3];
+    }
+    for (; i < n; i++) a0 += (unsigned)p[i];
+    return (int)(a0 + a1 + a2 + a3);
+}
+
+/**
+ * a + b wrapping in two's complement for integers (a plain + otherwise), to
+ * combine the partials of the wrapping int sums without signed overflow
+ */
+struct wrapping_plus {
+    template <typename T>
+    constexpr T operator()(const T &a, const T &b) const {
+        if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+            using U = std::make_unsigned_t<T>;
+            return (T)((U)a + (U)b);
+        } else {
+            return a + b;
+        }
+    }
+};
+
+#ifdef SIMD_SUM_X86
+SIMD_TARGET("sse2") inline int sum_int_sse2(const int *p, size_t n) {
+    __m128i a0 = _mm_setzero_si128(), a1 = a0, a2 = a0, a3 = a0;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        a0 = _mm_add_epi32(a0, _mm_loadu_si128((const __m128i *)(p + i)));
+        a1 = _mm_add_epi32(a1, _mm_loadu_si128((const __m128i *)(p + i + 4)));
+        a2 = _mm_add_epi32(a2, _mm_loadu_si128((const __m128i *)(p + i + 8)));
+        a3 = _mm_add_epi32(a3, _mm_loadu_si128((const __m128i *)(p + i + 12)));
+    }
+    __m128i acc = _mm_add_epi32(_mm_add_epi32(a0, a1), _mm_add_epi32(a2, a3));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+    acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (int)((unsigned)_mm_cvtsi128_si32(acc) + (unsigned)sum_int_scalar(p + i, n - i));
+}
+
+SIMD_TARGET("avx2") inline int sum_int_avx2(const int *p, size_t n) {
+    __m256i a0 = _mm256_setzero_si256(), a1 = a0, a2 = a0, a3 = a0;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        a0 = _mm256_add_epi32(a0, _mm256_loadu_si256((const __m256i *)(p + i)));
+        a1 = _mm256_add_epi32(a1, _mm256_loadu_si256((const __m256i *)(p + i + 8)));
+        a2 = _mm256_add_epi32(a2, _mm256_loadu_si256((const __m256i *)(p + i + 16)));
+        a3 = _mm256_add_epi32(a3, _mm256_loadu_si256((const __m256i *)(p + i + 24)));
+    }
+    __m256i acc = _mm256_add_epi32(_mm256_add_epi32(a0, a1), _mm256_add_epi32(a2, a3));
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (int)((unsigned)_mm_cvtsi128_si32(half) + (unsigned)sum_int_scalar(p + i, n - i));
+}
+
+SIMD_TARGET("avx512f") inline int sum_int_avx512(const int *p, size_t n) {
+    __m512i a0 = _mm512_setzero_si512(), a1 = a0, a2 = a0, a3 = a0;
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        a0 = _mm512_add_epi32(a0, _mm512_loadu_si512(p + i));
+        a1 = _mm512_add_epi32(a1, _mm512_loadu_si512(p + i + 16));
+        a2 = _mm512_add_epi32(a2, _mm512_loadu_si512(p + i + 32));
+        a3 = _mm512_add_epi32(a3, _mm512_loadu_si512(p + i + 48));
+    }
+    // the tail is done with a masked load rather than a scalar loop
+    __m512i acc = _mm512_add_epi32(_mm512_add_epi32(a0, a1), _mm512_add_epi32(a2, a3));
+    for (; i < n; i += 16) {
+        size_t left = n - i < 16 ? n - i : 16;
+        __mmask16 m = (__mmask16)((1u << left) - 1);
+        acc = _mm512_add_epi32(acc, _mm512_maskz_loadu_epi32(m, p + i));
+    }
+    alignas(64) int lanes[16];
+    _mm512_store_si512(lanes, acc);
+    unsigned total = 0;
+    for (int l = 0; l < 16; l++) total += (unsigned)lanes[l];
+    return (int)total;
+}
+#endif
+
+/**
+ * Sums n ints with the best kernel for this CPU
+ */
+inline int sum_int(const int *p, size_t n) {
+#ifdef SIMD_SUM_X86
+    switch (active_simd_level()) {
+        case simd_level::avx512:
+            return sum_int_avx512(p, n);
+        case simd_level::avx2:
+            return sum_int_avx2(p, n);
+        case simd_level::sse2:
+            return sum_int_sse2(p, n);
+        default:
+            break;
+    }
+#endif
+    return sum_int_scalar(p, n);
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "histogram.h"
+#include "reduce.h"
+#include "scan.h"
+#include "thread_pool.h"
+
+/**
+ * Parallel sorts on the reduction chunking.
+ *   - LSD radix sort for integer keys, one byte per pass: every chunk
+ *     counts its digits with count_bins (the private pass of the
+ *     privatized histogram), an exclusive parallel_scan of the counts
+ *     laid out digit-major gives every (digit, chunk) pair its output
+ *     offset, and every chunk scatters its keys stably to those offsets.
+ *     The scan runs under the caller's policy, so in auto mode it stays
+ *     inline until the count table is large. Passes whose digit is the
+ *     same for every key are skipped
+ *   - merge sort for any comparator: chunks are stable sorted in parallel,
+ *     then runs are merged pairwise. Each merge is split at merge path
+ *     diagonals so even the last round, a single merge, keeps every
+ *     thread busy. The sort is stable
+ * Both need a buffer as large as the input
+ */
+inline constexpr size_t sort_sequential_cutoff = 1 << 14;
+inline constexpr int radix_bits = 8;
+inline constexpr size_t radix_buckets = (size_t)1 << radix_bits;
+
+template <typename T>
+std::make_unsigned_t<T> radix_key(T v) {
+    using U = std::make_unsigned_t<T>;
+    // flipping the sign bit orders signed keys like their unsigned images
+    if constexpr (std::is_signed_v<T>) {
+        return (U)v ^ ((U)1 << (sizeof(T) * 8 - 1));
+    } else {
+        return v;
+    }
+}
+
+/**
+ * Sorts integer keys ascending
+ */
+template <typename T>
+void parallel_radix_sort(std::vector<T> &keys,
+                         reduce_policy policy = reduce_policy::auto_threads) {
+    static_assert(std::is_integral_v<T> && !std::is_same_v<T, bool>,
+                  "radix sort needs integer keys");
+    size_t n = keys.size();
+    if (n < sort_sequential_cutoff) {
+        std::sort(keys.begin(), keys.end());
+        return;
+    }
+    // the offsets scan is sized by the count table, not the keys
+    reduce_policy scanPolicy = policy;
+    // every pass reads and writes each key twice
+    policy.costScale *= 4 * sizeof(T) / (double)sizeof(int);
+    policy = resolve_policy(n, policy);
+    auto chunks = partition_range(n, policy.numThreads, policy.grain);
+    size_t parts = chunks.size();
+    std::vector<T> buffer(n);
+    T *src = keys.data(), *dst = buffer.data();
+    // counts[digit * parts + chunk], scanned in place into offsets
+    std::vector<uint64_t> counts(radix_buckets * parts);
+    thread_pool &pool = default_pool();
+
+    for (int shift = 0; shift < (int)sizeof(T) * 8; shift += radix_bits) {
+        auto digit = [shift](T v) { return (size_t)(radix_key(v) >> shift) & (radix_buckets - 1); };
+        pool.parallel_for(
+            parts,
+            [&](size_t c) {
+                uint64_t local[radix_buckets] = {};
+                count_bins(src, chunks[c].first, chunks[c].second, radix_buckets, digit, local);
+                for (size_t d = 0; d < radix_buckets; d++) counts[d * parts + c] = local[d];
+            },
+            policy.numThreads);
+
+        bool trivial = false;
+        for (size_t d = 0; d < radix_buckets && !trivial; d++) {
+            uint64_t total = 0;
+            for (size_t c = 0; c < parts; c++) total += counts[d * parts + c];
+            trivial = total == n;
+        }
+        if (trivial) continue;
+
+        parallel_scan(counts.data(), counts.data(), counts.size(), (uint64_t)0, true, scanPolicy);
+        pool.parallel_for(
+            parts,
+            [&](size_t c) {
+                size_t offsets[radix_buckets];
+                for (size_t d = 0; d < radix_buckets; d++) offsets[d] = counts[d * parts + c];
+                for (size_t i = chunks[c].first; i < chunks[c].second; i++) {
+                    dst[offsets[digit(src[i])]++] = src[i];
+                }
+            },
+            policy.numThreads);
+        std::swap(src, dst);
+    }
+
+    if (src != keys.data()) {
+        const T *from = src;
+        T *to = keys.data();
+        for_each_chunk(
+            n, [from, to](size_t b, size_t e) { std::copy(from + b, from + e, to + b); }, policy);
+    }
+}
+
+/**
+ * Number of elements of a that come before the d-th element of the stable
+ * merge of a and b (ties take a first)
+ */
+template <typename It, typename Compare>
+size_t merge_path_split(It a, size_t na, It b, size_t nb, size_t d, Compare &comp) {
+    size_t lo = d > nb ? d - nb : 0, hi = std::min(d, na);
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2, j = d - i;
+        // a[i] not after b[j - 1] means a[i] belongs in the first d too
+        if (!comp(b[j - 1], a[i])) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+// std::merge moving the elements; comp sees lvalues, ties take a first
+template <typename In, typename Out, typename Compare>
+void move_merge(In a, In aEnd, In b, In bEnd, Out out, Compare &comp) {
+    while (a != aEnd && b != bEnd) {
+        if (comp(*b, *a)) {
+            *out++ = std::move(*b++);
+        } else {
+            *out++ = std::move(*a++);
+        }
+    }
+    out = std::move(a, aEnd, out);
+    std::move(b, bEnd, out);
+}
+
+/**
+ * Sorts [first, last) with comp, stably
+ */
+template <typename It, typename Compare = std::less<>>
+void parallel_merge_sort(It first, It last, Compare comp = Compare(),
+                         reduce_policy policy = reduce_policy::auto_threads) {
+    using T = typename std::iterator_traits<It>::value_type;
+    size_t n = (size_t)std::distance(first, last);
+    if (n < sort_sequential_cutoff) {
+        std::stable_sort(first, last, comp);
+        return;
+    }
+    // log n comparisons per element; the cost model only needs a rough scale
+    policy.costScale *= 8;
+    policy = resolve_policy(n, policy);
+    auto runs = partition_range(n, policy.numThreads, policy.grain);
+    thread_pool &pool = default_pool();
+    pool.parallel_for(
+        runs.size(),
+        [&](size_t r) { std::stable_sort(first + runs[r].first, first + runs[r].second, comp); },
+        policy.numThreads);
+
+    std::vector<T> buffer(n);
+    bool inBuffer = false;
+    // merge pieces per round, so a round with few merges still splits
+    size_t pieces = (size_t)policy.numThreads;
+    while (runs.size() > 1) {
+        std::vector<std::pair<size_t, size_t>> merged;
+        struct task {
+            size_t a, na, b, nb, piece, piecesInMerge;
+        };
+        std::vector<task> tasks;
+        for (size_t r = 0; r < runs.size(); r += 2) {
+            size_t a = runs[r].first, na = runs[r].second - a;
+            size_t nb = r + 1 < runs.size() ? runs[r + 1].second - runs[r + 1].first : 0;
+            size_t per = std::max<size_t>(1, pieces / ((runs.size() + 1) / 2));
+            for (size_t p = 0; p < per; p++) tasks.push_back({a, na, a + na, nb, p, per});
+            merged.emplace_back(a, a + na + nb);
+        }
+
+        auto round = [&](auto from, auto to) {
+            pool.parallel_for(
+                tasks.size(),
+                [&](size_t t) {
+                    const task &k = tasks[t];
+                    size_t total = k.na + k.nb;
+                    size_t d0 = total * k.piece / k.piecesInMerge;
+                    size_t d1 = total * (k.piece + 1) / k.piecesInMerge;
+                    auto a = from + k.a, b = from + k.b;
+                    size_t i0 = merge_path_split(a, k.na, b, k.nb, d0, comp);
+                    size_t i1 = merge_path_split(a, k.na, b, k.nb, d1, comp);
+                    move_merge(a + i0, a + i1, b + (d0 - i0), b + (d1 - i1), to + k.a + d0,
+                               comp);
+                },
+                policy.numThreads);
+        };
+        if (inBuffer) {
+            round(buffer.begin(), first);
+        } else {
+            round(first, buffer.begin());
+        }
+        inBuffer = !inBuffer;
+        runs = std::move(merged);
+    }
+
+    if (inBuffer) {
+        for_each_chunk(
+            n,
+            [&](size_t b, size_t e) {
+                std::move(buffer.begin() + b, buffer.begin() + e, first + b);
+            },
+            policy);
+    }
+}
+
+template <typename T, typename Compare = std::less<>>
+void parallel_merge_sort(std::vector<T> &values, Compare comp = Compare(),
+                         reduce_policy policy = reduce_policy::auto_threads) {
+    parallel_merge_sort(values.begin(), values.end(), comp, policy);
+}
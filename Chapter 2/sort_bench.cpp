@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "sort.h"
+#include "timing.h"
+
+/**
+ * std::sort against the parallel radix and merge sorts on random 32 and
+ * 64 bit keys. Try sizes from 10M up to 1B (a 1B run of 64 bit keys needs
+ * around 24 GB: input, a reference copy and the sort buffer).
+ *
+ * usage: sort_bench [elements] [threads]
+ */
+template <typename T>
+bool run(const char *name, size_t n, reduce_policy policy) {
+    std::mt19937_64 rng(42);
+    std::vector<T> input(n);
+    for (auto &v : input) v = (T)rng();
+
+    std::vector<T> expected = input;
+    double stdTime = time_seconds([&] { std::sort(expected.begin(), expected.end()); });
+    std::vector<T> radix = input;
+    double radixTime = time_seconds([&] { parallel_radix_sort(radix, policy); });
+    bool ok = radix == expected;
+    radix = std::vector<T>();
+    std::vector<T> merge = std::move(input);
+    double mergeTime = time_seconds([&] { parallel_merge_sort(merge, std::less<>(), policy); });
+    ok = ok && merge == expected;
+
+    std::cout << std::setw(8) << name << std::setw(12) << stdTime * 1e3 << std::setw(12)
+              << radixTime * 1e3 << std::setw(12) << mergeTime * 1e3 << std::endl;
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    reduce_policy policy = argc > 2 ? reduce_policy(std::atoi(argv[2]))
+                                    : reduce_policy(reduce_policy::auto_threads);
+
+    std::cout << n << " elements, times in ms" << std::endl;
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << std::setw(8) << "keys" << std::setw(12) << "std::sort" << std::setw(12)
+              << "radix" << std::setw(12) << "merge" << std::endl;
+    bool ok = run<int32_t>("int32", n, policy);
+    ok = run<uint64_t>("uint64", n, policy) && ok;
+    std::cout << "Correct: " << (ok ? "Yes" : "No") << std::endl;
+    return ok ? 0 : 1;
+}
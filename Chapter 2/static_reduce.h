@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "reduce.h"
+#include "simd_sum.h"
+
+/**
+ * Reduction kernels specialized at compile time on the element type, the
+ * accumulator type, the unroll factor and the op, so the inner loop has no
+ * runtime op selection or function pointer left in it. Arithmetic and
+ * other trivially copyable elements are folded into Unroll independent
+ * accumulators, which the compiler keeps in (vector) registers; anything
+ * else is folded into one accumulator straight from the input. Which
+ * instantiation runs is picked per call from a constexpr table indexed by
+ * the ISA and the size class of the input: short inputs take a narrow
+ * unroll with no vector tail to finish, long ones the widest unroll that
+ * still fits the registers
+ */
+struct plus_op {
+    template <typename A>
+    static constexpr A identity() {
+        return A{};
+    }
+    template <typename A, typename V>
+    static constexpr A apply(const A &a, const V &v) {
+        // ints wrap like the SIMD kernels do instead of overflowing
+        if constexpr (std::is_integral_v<A> && !std::is_same_v<A, bool>) {
+            using U = std::make_unsigned_t<A>;
+            return (A)((U)a + (U)(A)v);
+        } else {
+            return a + v;
+        }
+    }
+};
+
+struct min_op {
+    template <typename A>
+    static constexpr A identity() {
+        // numeric_limits gives A{} for types it doesn't know, which is no identity
+        static_assert(std::numeric_limits<A>::is_specialized, "min needs a numeric type");
+        return std::numeric_limits<A>::max();
+    }
+    template <typename A, typename V>
+    static constexpr A apply(const A &a, const V &v) {
+        return (A)v < a ? (A)v : a;
+    }
+};
+
+struct max_op {
+    template <typename A>
+    static constexpr A identity() {
+        static_assert(std::numeric_limits<A>::is_specialized, "max needs a numeric type");
+        return std::numeric_limits<A>::lowest();
+    }
+    template <typename A, typename V>
+    static constexpr A apply(const A &a, const V &v) {
+        return a < (A)v ? (A)v : a;
+    }
+};
+
+struct xor_op {
+    template <typename A>
+    static constexpr A identity() {
+        return A{};
+    }
+    template <typename A, typename V>
+    static constexpr A apply(const A &a, const V &v) {
+        return a ^ (A)v;
+    }
+};
+
+// one step of every accumulator, expanded at compile time rather than left
+// to the loop unroller, which gives up on long fixed-trip loops at -O2
+template <typename Op, typename T, typename Acc, size_t... U>
+inline __attribute__((always_inline)) void reduce_step(Acc *acc, const T *p,
+                                                       std::index_sequence<U...>) {
+    ((acc[U] = Op::apply(acc[U], p[U])), ...);
+}
+
+// the body every instantiation shares, inlined into each ISA's clone
+template <typename T, typename Acc, int Unroll, typename Op>
+inline __attribute__((always_inline)) Acc reduce_kernel_body(const T *p, size_t n) {
+    static_assert(Unroll >= 1 && Unroll <= 64, "unroll factor out of range");
+    if constexpr (std::is_trivially_copyable_v<T> && std::is_trivially_copyable_v<Acc>) {
+        Acc acc[Unroll];
+        for (int u = 0; u < Unroll; u++) acc[u] = Op::template identity<Acc>();
+        size_t i = 0;
+        for (; i + Unroll <= n; i += Unroll) {
+            reduce_step<Op>(acc, p + i, std::make_index_sequence<Unroll>());
+        }
+        for (; i < n; i++) acc[0] = Op::apply(acc[0], p[i]);
+        // pairwise fold of the accumulators
+        for (int width = Unroll; width > 1; width = (width + 1) / 2) {
+            for (int u = 0; u < width / 2; u++) {
+                acc[u] = Op::apply(acc[u], acc[u + (width + 1) / 2]);
+            }
+        }
+        return acc[0];
+    } else {
+        Acc acc = Op::template identity<Acc>();
+        for (size_t i = 0; i < n; i++) acc = Op::apply(acc, p[i]);
+        return acc;
+    }
+}
+
+template <typename T, typename Acc, int Unroll, typename Op>
+Acc reduce_kernel(const T *p, size_t n) {
+    return reduce_kernel_body<T, Acc, Unroll, Op>(p, n);
+}
+
+#ifdef SIMD_SUM_X86
+template <typename T, typename Acc, int Unroll, typename Op>
+SIMD_TARGET("avx2") Acc reduce_kernel_avx2(const T *p, size_t n) {
+    return reduce_kernel_body<T, Acc, Unroll, Op>(p, n);
+}
+#endif
+
+/**
+ * Size classes of the dispatch table: tiny inputs aren't worth more than
+ * one accumulator, small ones take one vector of them and large ones four,
+ * so four vector adds are in flight per iteration
+ */
+inline constexpr size_t kernel_size_classes = 3;
+inline constexpr size_t kernel_small_size = 16;
+inline constexpr size_t kernel_large_size = 1024;
+
+constexpr size_t kernel_size_class(size_t n) {
+    return n < kernel_small_size ? 0 : n < kernel_large_size ? 1 : 2;
+}
+
+template <typename Acc>
+constexpr int kernel_unroll(size_t sizeClass, size_t vectorBytes) {
+    if (sizeClass == 0 || !std::is_arithmetic_v<Acc>) return 1;
+    size_t lanes = std::max<size_t>(1, vectorBytes / sizeof(Acc));
+    return (int)std::min<size_t>(64, sizeClass == 1 ? lanes : 4 * lanes);
+}
+
+template <typename T, typename Acc, typename Op>
+struct reduce_kernel_table {
+    using kernel_fn = Acc (*)(const T *, size_t);
+
+    // rows: the baseline ISA (16 byte vectors), then AVX2 (32 bytes)
+    static constexpr kernel_fn kernels[][kernel_size_classes] = {
+        {&reduce_kernel<T, Acc, kernel_unroll<Acc>(0, 16), Op>,
+         &reduce_kernel<T, Acc, kernel_unroll<Acc>(1, 16), Op>,
+         &reduce_kernel<T, Acc, kernel_unroll<Acc>(2, 16), Op>},
+#ifdef SIMD_SUM_X86
+        {&reduce_kernel_avx2<T, Acc, kernel_unroll<Acc>(0, 32), Op>,
+         &reduce_kernel_avx2<T, Acc, kernel_unroll<Acc>(1, 32), Op>,
+         &reduce_kernel_avx2<T, Acc, kernel_unroll<Acc>(2, 32), Op>},
+#endif
+    };
+
+    static kernel_fn select(size_t n) {
+        size_t isa = 0;
+#ifdef SIMD_SUM_X86
+        if (active_simd_level() >= simd_level::avx2) isa = 1;
+#endif
+        return kernels[isa][kernel_size_class(n)];
+    }
+};
+
+/**
+ * Reduces n elements with Op into an Acc through the instantiation the
+ * table picks for this CPU and size
+ */
+template <typename Op, typename Acc = void, typename T>
+auto static_reduce(const T *p, size_t n) {
+    using A = std::conditional_t<std::is_void_v<Acc>, T, Acc>;
+    return reduce_kernel_table<T, A, Op>::select(n)(p, n);
+}
+
+/**
+ * Parallel static_reduce over a vector on the reduction chunking; every
+ * chunk looks up the kernel for its own length once
+ */
+template <typename Op, typename Acc = void, typename T>
+auto static_reduce_vector(const std::vector<T> &arr,
+                          reduce_policy policy = reduce_policy::auto_threads) {
+    using A = std::conditional_t<std::is_void_v<Acc>, T, Acc>;
+    const T *data = arr.data();
+    auto chunk = [data](size_t b, size_t e) { return static_reduce<Op, A>(data + b, e - b); };
+    auto combine = [](const A &a, const A &b) { return Op::apply(a, b); };
+    policy.costScale *= sizeof(T) / (double)sizeof(int);
+    return reduce_chunks(arr.size(), Op::template identity<A>(), chunk, combine, policy);
+}
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "reduce.h"
+#include "static_reduce.h"
+#include "timing.h"
+
+/**
+ * Thread scaling benchmark for sum_vector. Compares the padded,
+ * register-accumulating workers against the original layout where every
+ * worker adds straight into a packed array of partial sums, both on the
+ * thread pool, so the cost of false sharing shows up directly next to the
+ * scaling curve. A single thread table first compares the vectorized
+ * kernels by ISA and the compile-time specialized template kernel,
+ * followed by the widening and floating point accumulation modes.
+ *
+ * usage: sum_bench [elements] [max_threads] [repetitions]
+ */
+struct PackedWork {
+    const int *arr;
+    size_t begin, end;
+    int sum;
+
+    void operator()() {
+        for (size_t i = begin; i < end; i++) sum += arr[i];
+    }
+};
+
+int packed_sum(std::vector<int> &arr, int numThreads) {
+    std::vector<PackedWork> workers(numThreads);
+    size_t chunkSize = (arr.size() + numThreads - 1) / numThreads;
+    for (int t = 0; t < numThreads; t++) {
+        size_t b = std::min(arr.size(), t * chunkSize);
+        workers[t] = {arr.data(), b, std::min(arr.size(), b + chunkSize), 0};
+    }
+    // on the same pool as sum_vector, so thread start-up isn't part of the gap
+    default_pool().parallel_for(
+        workers.size(), [&](size_t t) { workers[t](); }, numThreads);
+    int total = 0;
+    for (const auto &w : workers) total += w.sum;
+    return total;
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : (size_t)1 << 26;
+    int maxThreads = argc > 2 ? std::atoi(argv[2])
+                              : std::max(32, (int)std::thread::hardware_concurrency());
+    int reps = argc > 3 ? std::atoi(argv[3]) : 5;
+
+    // small values so the int accumulators can't overflow
+    std::vector<int> data(n);
+    for (size_t i = 0; i < n; i++) data[i] = (int)(i & 7);
+    int expected = 0;
+    for (size_t i = 0; i < n; i++) expected += data[i];
+
+    double bytes = n * sizeof(int);
+    std::cout << "elements: " << n << " (" << bytes / (1 << 20) << " MiB), hardware threads: "
+              << std::thread::hardware_concurrency() << std::endl;
+
+    // single core kernel comparison; a plain indexed loop stands in for the
+    // old Work::operator()
+    simd_level detected = detect_simd_level();
+    double naive = best_seconds(reps, [&] {
+        volatile int sink = 0;
+        for (size_t i = 0; i < n; i++) sink = sink + data[i];
+    });
+    std::cout << std::setw(14) << "kernel" << std::setw(14) << "GB/s" << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << std::setw(14) << "naive" << std::setw(14)
+              << bytes / naive / 1e9 << std::endl;
+    for (simd_level l : {simd_level::scalar, simd_level::sse2, simd_level::avx2,
+                         simd_level::avx512}) {
+        if (l > detected) break;
+        set_simd_level(l);
+        int r = 0;
+        double t = best_seconds(reps, [&] { r = sum_int(data.data(), n); });
+        if (r != expected) {
+            std::cerr << "wrong result from " << simd_level_name(l) << std::endl;
+            return 1;
+        }
+        std::cout << std::setw(14) << simd_level_name(l) << std::setw(14) << bytes / t / 1e9
+                  << std::endl;
+    }
+    set_simd_level(detected);
+    // the compile-time specialized kernel against the hand written ones
+    int templated = 0;
+    double templateTime =
+        best_seconds(reps, [&] { templated = static_reduce<plus_op>(data.data(), n); });
+    if (templated != expected) {
+        std::cerr << "wrong result from template kernel" << std::endl;
+        return 1;
+    }
+    std::cout << std::setw(14) << "template" << std::setw(14) << bytes / templateTime / 1e9
+              << std::endl;
+
+    std::vector<double> fp(data.begin(), data.end());
+    long long wide = 0;
+    double wideTime = best_seconds(reps, [&] { wide = sum_int_wide(data.data(), n); });
+    if (wide != expected) {
+        std::cerr << "wrong result from wide sum" << std::endl;
+        return 1;
+    }
+    std::cout << std::setw(14) << "int64" << std::setw(14) << bytes / wideTime / 1e9 << std::endl;
+    for (sum_mode m : {sum_mode::fast, sum_mode::kahan, sum_mode::neumaier, sum_mode::pairwise,
+                       sum_mode::deterministic}) {
+        double r = 0;
+        double t = best_seconds(reps, [&] { r = sum_fp(fp.data(), n, m).value(); });
+        if (r != expected) {
+            std::cerr << "wrong result from " << sum_mode_name(m) << std::endl;
+            return 1;
+        }
+        std::cout << std::setw(14) << sum_mode_name(m) << std::setw(14)
+                  << n * sizeof(double) / t / 1e9 << std::endl;
+    }
+
+    // the deterministic mode must not depend on the split or the kernel
+    std::vector<double> noisy(n);
+    for (size_t i = 0; i < n; i++) noisy[i] = 0.1 * (double)(i % 7) + 1e-7 * (double)i;
+    double reference = sum_vector(noisy, 1, sum_mode::deterministic);
+    bool reproducible = true;
+    for (simd_level l : {simd_level::scalar, detected}) {
+        set_simd_level(l);
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            reproducible &= sum_vector(noisy, threads, sum_mode::deterministic) == reference;
+            reduce_policy dynamic(threads, schedule::dynamic);
+            reproducible &= sum_vector(noisy, dynamic, sum_mode::deterministic) == reference;
+        }
+    }
+    set_simd_level(detected);
+    std::cout << "deterministic across thread counts and kernels: "
+              << (reproducible ? "Yes" : "No") << std::endl;
+    std::cout << std::endl;
+
+    std::cout << std::setw(8) << "threads" << std::setw(14) << "packed GB/s" << std::setw(14)
+              << "padded GB/s" << std::setw(10) << "speedup" << std::setw(12) << "efficiency"
+              << std::endl;
+    double base = 0;
+    for (int threads = 1; threads <= maxThreads; threads *= 2) {
+        int a = 0, b = 0;
+        double packed = best_seconds(reps, [&] { a = packed_sum(data, threads); });
+        double padded = best_seconds(reps, [&] { b = sum_vector(data, threads); });
+        if (a != expected || b != expected) {
+            std::cerr << "wrong result at " << threads << " threads" << std::endl;
+            return 1;
+        }
+        if (threads == 1) base = padded;
+        std::cout << std::fixed << std::setprecision(2) << std::setw(8) << threads
+                  << std::setw(14) << bytes / packed / 1e9 << std::setw(14)
+                  << bytes / padded / 1e9 << std::setw(10) << base / padded << std::setw(11)
+                  << 100 * base / padded / threads << "%" << std::endl;
+    }
+    return 0;
+}
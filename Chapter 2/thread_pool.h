@@ -0,0 +1,164 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Long-lived pool of worker threads that park on a condition variable
+ * between tasks, so data-parallel calls don't pay thread creation and
+ * teardown every time
+ */
+class thread_pool {
+   private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> tasks;
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = false;
+
+    void worker_loop() {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(m);
+                cv.wait(lock, [this] { return done || !tasks.empty(); });
+                if (tasks.empty()) return;
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    /**
+     * State shared by the caller and the helpers of one parallel_for. It is
+     * reference counted because helpers can start after the caller has
+     * already finished every index and returned
+     */
+    struct for_state {
+        std::atomic<size_t> next{0};
+        size_t count;
+        std::mutex m;
+        std::condition_variable cv;
+        size_t completed = 0;
+        std::exception_ptr error;
+
+        explicit for_state(size_t n) : count(n) {}
+
+        template <typename F>
+        void run(F &fn) {
+            size_t finished = 0;
+            for (size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1)) {
+                try {
+                    fn(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(m);
+                    if (!error) error = std::current_exception();
+                }
+                finished++;
+            }
+            if (finished == 0) return;
+            std::lock_guard<std::mutex> lock(m);
+            completed += finished;
+            if (completed == count) cv.notify_all();
+        }
+    };
+
+   public:
+    explicit thread_pool(unsigned numThreads = std::max(1u, std::thread::hardware_concurrency()))
+        : thread_pool(numThreads, nullptr) {}
+
+    /**
+     * onStart(i) runs first thing on worker i, e.g. to pin it to a core
+     */
+    thread_pool(unsigned numThreads, std::function<void(unsigned)> onStart) {
+        threads.reserve(numThreads);
+        for (unsigned i = 0; i < numThreads; i++) {
+            threads.emplace_back([this, i, onStart] {
+                if (onStart) onStart(i);
+                worker_loop();
+            });
+        }
+    }
+
+    ~thread_pool() {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            done = true;
+        }
+        cv.notify_all();
+        for (auto &t : threads) {
+            if (t.joinable()) t.join();
+        }
+    }
+
+    thread_pool(const thread_pool &) = delete;
+    thread_pool &operator=(const thread_pool &) = delete;
+
+    size_t size() const { return threads.size(); }
+
+    void submit(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> lock(m);
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
+    }
+
+    /**
+     * Calls fn(i) for every i in [0, count) and returns once all calls are
+     * done. The calling thread claims indices alongside the workers, so a
+     * parallel_for issued from inside a pool task still makes progress.
+     * At most maxParallelism threads (caller included) work on the loop.
+     * The first exception thrown by fn is rethrown here
+     */
+    template <typename F>
+    void parallel_for(size_t count, F &&fn, size_t maxParallelism = SIZE_MAX) {
+        if (count == 0) return;
+        if (count == 1) {
+            fn(0);
+            return;
+        }
+        auto state = std::make_shared<for_state>(count);
+        size_t helpers = std::min(count - 1, threads.size());
+        helpers = std::min(helpers, std::max<size_t>(maxParallelism, 1) - 1);
+        for (size_t h = 0; h < helpers; h++) {
+            // fn is only touched by helpers that claim an index, and the
+            // caller waits for every claimed index before fn goes away
+            submit([state, &fn] { state->run(fn); });
+        }
+        state->run(fn);
+
+        std::unique_lock<std::mutex> lock(state->m);
+        state->cv.wait(lock, [&] { return state->completed == count; });
+        if (state->error) std::rethrow_exception(state->error);
+    }
+};
+
+/**
+ * Process-wide pool shared by the parallel reductions
+ */
+inline thread_pool &default_pool() {
+    static thread_pool pool;
+    return pool;
+}
+
+/**
+ * Most threads worth putting on one loop of the default pool: its workers
+ * plus the calling thread, but no more than the hardware runs at once, as
+ * the caller works alongside the workers
+ */
+inline int default_parallelism() {
+    size_t hardware = std::max(1u, std::thread::hardware_concurrency());
+    return (int)std::min(default_pool().size() + 1, hardware);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+/**
+ * Wall clock timing shared by the benchmarks and the calibration, all in
+ * seconds
+ */
+template <typename F>
+double time_seconds(F &&f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    return d.count();
+}
+
+/**
+ * Fastest of reps runs, for throughput where noise only ever adds time
+ */
+template <typename F>
+double best_seconds(int reps, F &&f) {
+    double best = 1e30;
+    for (int r = 0; r < reps; r++) best = std::min(best, time_seconds(f));
+    return best;
+}
+
+/**
+ * Median of at least reps runs. With a budget, sampling goes on (up to
+ * 10000 runs) until that many seconds have passed, so short calls still
+ * get a stable median without long ones dragging on
+ */
+template <typename F>
+double median_seconds(int reps, F &&f, double budget = 0) {
+    std::vector<double> samples;
+    double elapsed = 0;
+    while ((int)samples.size() < reps || (samples.size() < 10000 && elapsed < budget)) {
+        samples.push_back(time_seconds(f));
+        elapsed += samples.back();
+    }
+    std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
+    return samples[samples.size() / 2];
+}